@@ -0,0 +1,31 @@
+# Settings shared by the core library, the app and the benchmark.  Each
+# project sets TARGET before including this.
+
+CONFIG += qt debug_and_release console
+MOC_DIR = ./moc
+RCC_DIR = ./qrc
+OBJECTS_DIR = ./release
+DESTDIR = $$PWD/release
+CONFIG(debug,debug|release) {
+	OBJECTS_DIR = ./debug
+	DESTDIR = $$PWD/debug
+}
+
+win32 {
+	SLASH = \\
+}
+linux-g++ {
+	SLASH = /
+}
+
+INCLUDEPATH += $$PWD/src
+
+# Everything but the core library links against it.
+!equals(TARGET, LoomPreviewCore) {
+	LIBS += -L$$DESTDIR -lLoomPreviewCore
+	win32 {
+		PRE_TARGETDEPS += $$DESTDIR/LoomPreviewCore.lib
+	} else {
+		PRE_TARGETDEPS += $$DESTDIR/libLoomPreviewCore.a
+	}
+}
@@ -1,37 +1,13 @@
-CONFIG += qt
-CONFIG += uitools debug_and_release console
-UI_HEADERS_DIR = ./ui_inc
-MOC_DIR = ./moc
-RCC_DIR = ./qrc
-OBJECTS_DIR = ./release
-DESTDIR = ./release
-CONFIG(debug,debug|release) {
-	OBJECTS_DIR = ./debug
-	DESTDIR = ./debug
-}
-TARGET = LoomPreview
-
-win32 {
-	SLASH = \\
-}
-linux-g++ {
-	SLASH = /
-}
-
-INCLUDEPATH += src
-INCLUDEPATH += $${UI_HEADERS_DIR}
-
-
-TEMPLATE = app
-
-FORMS = ui/MainWindow.ui 
-
-RESOURCES = ui/LoomPreview.qrc
-
-SOURCES +=  src/LPImager.cpp \
-            src/LPMain.cpp \
-            src/LPMainWindow.cpp 
-
-HEADERS +=  src/LPImager.h \
-            src/LPMainWindow.h 
-
+# Builds the imaging core as a library, then the app, the benchmark and
+# the kernel check on top of it.
+TEMPLATE = subdirs
+
+SUBDIRS = core app bench kernelcheck
+
+core.file = LoomPreviewCore.pro
+app.file = LoomPreviewApp.pro
+app.depends = core
+bench.file = bench/bench.pro
+bench.depends = core
+kernelcheck.file = bench/kernelcheck.pro
+kernelcheck.depends = core
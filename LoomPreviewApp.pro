@@ -0,0 +1,35 @@
+TARGET = LoomPreview
+include(LoomPreview.pri)
+
+CONFIG += uitools
+UI_HEADERS_DIR = ./ui_inc
+
+INCLUDEPATH += $${UI_HEADERS_DIR}
+
+
+TEMPLATE = app
+
+FORMS = ui/MainWindow.ui 
+
+RESOURCES = ui/LoomPreview.qrc
+
+SOURCES +=  src/LPPreviewWidget.cpp \
+            src/LPRenderScheduler.cpp \
+            src/LPEntropyStrip.cpp \
+            src/LPHexInspector.cpp \
+            src/LPHypothesisGrid.cpp \
+            src/LPMain.cpp \
+            src/LPMainWindow.cpp \
+            src/LPStridePanel.cpp \
+            src/LPWorker.cpp \
+            src/LPOverviewWidget.cpp 
+
+HEADERS +=  src/LPPreviewWidget.h \
+            src/LPEntropyStrip.h \
+            src/LPHexInspector.h \
+            src/LPHypothesisGrid.h \
+            src/LPRenderScheduler.h \
+            src/LPMainWindow.h \
+            src/LPStridePanel.h \
+            src/LPWorker.h \
+            src/LPOverviewWidget.h 
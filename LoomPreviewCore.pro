@@ -0,0 +1,34 @@
+# The imaging core: loading, decoding, caching and exporting, with no UI.
+TARGET = LoomPreviewCore
+include(LoomPreview.pri)
+
+TEMPLATE = lib
+CONFIG += staticlib
+
+SOURCES +=  src/LPBatch.cpp \
+            src/LPBitReader.cpp \
+            src/LPEntropyMap.cpp \
+            src/LPExporter.cpp \
+            src/LPImagePool.cpp \
+            src/LPPixelDecoders.cpp \
+            src/LPProfiler.cpp \
+            src/LPSimdRows.cpp \
+            src/LPStrideDetector.cpp \
+            src/LPTileCache.cpp \
+            src/LPTiffWriter.cpp \
+            src/LPImager.cpp \
+            src/LPOverview.cpp 
+
+HEADERS +=  src/LPBatch.h \
+            src/LPBitReader.h \
+            src/LPEntropyMap.h \
+            src/LPExporter.h \
+            src/LPImagePool.h \
+            src/LPImager.h \
+            src/LPPixelDecoders.h \
+            src/LPProfiler.h \
+            src/LPSimdRows.h \
+            src/LPStrideDetector.h \
+            src/LPTileCache.h \
+            src/LPTiffWriter.h \
+            src/LPOverview.h 
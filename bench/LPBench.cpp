@@ -0,0 +1,261 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+/* Times the imaging core on synthetic data:
+
+      LoomPreviewBench [--max-size MB] [--width N] [--threads N] [--dir DIR]
+
+   For files of 1 MB, 16 MB, 256 MB and 4 GB (up to --max-size) of random
+   bytes it reports how fast the file loads, how fast every row decodes
+   with each of a set of channel layouts, and how fast it exports as one
+   TIFF, as MB of source data and millions of pixels per second.
+*/
+
+#include "LPExporter.h"
+#include "LPImager.h"
+#include "LPTiffWriter.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+
+namespace
+{
+   const qint64   MB( 1024 * 1024 );
+
+   /// Widest row a QImage can hold (its bytes per line are an int).
+   const unsigned int   MaxWidth( INT_MAX / 4 );
+
+   struct Layout
+   {
+      const char*                name;
+      unsigned int               red, green, blue, gray, alpha;
+      LP::Imager::ChannelOrder   order;
+      LP::Imager::ByteOrder      byteOrder;
+   };
+
+   /// A mix of the layouts with vector, specialized and generic kernels.
+   const Layout   s_layouts[] =
+   {
+      { "gray 1",       0, 0, 0,  1, 0, LP::Imager::Grayscale, LP::Imager::BigEndian },
+      { "gray 8",       0, 0, 0,  8, 0, LP::Imager::Grayscale, LP::Imager::BigEndian },
+      { "gray 16 le",   0, 0, 0, 16, 0, LP::Imager::Grayscale, LP::Imager::LittleEndian },
+      { "rgb 3/3/2",    3, 3, 2,  0, 0, LP::Imager::RGB, LP::Imager::BigEndian },
+      { "rgb 5/6/5",    5, 6, 5,  0, 0, LP::Imager::RGB, LP::Imager::BigEndian },
+      { "bgr 5/6/5",    5, 6, 5,  0, 0, LP::Imager::BGR, LP::Imager::BigEndian },
+      { "rgb 8/8/8",    8, 8, 8,  0, 0, LP::Imager::RGB, LP::Imager::BigEndian },
+      { "brg 8/8/8",    8, 8, 8,  0, 0, LP::Imager::BRG, LP::Imager::BigEndian },
+      { "rgba 8/8/8/8", 8, 8, 8,  0, 8, LP::Imager::RGB, LP::Imager::BigEndian },
+      { "rgb 4/4/4",    4, 4, 4,  0, 0, LP::Imager::RGB, LP::Imager::BigEndian },
+      { "rgb 7/7/7",    7, 7, 7,  0, 0, LP::Imager::RGB, LP::Imager::BigEndian }
+   };
+
+   /// The layout exported; 8/8/8 keeps the TIFF the same size as the source.
+   const char* const s_exportLayout( "rgb 8/8/8" );
+
+   /// The file sizes tried, in MB.
+   const qint64   s_sizes[] = { 1, 16, 256, 4096 };
+
+
+   LP::Imager::RenderParams paramsFor( const Layout& layout, unsigned int width )
+   {
+      LP::Imager::RenderParams   params;
+
+      params.redBitCount = layout.red;
+      params.greenBitCount = layout.green;
+      params.blueBitCount = layout.blue;
+      params.grayBitCount = layout.gray;
+      params.alphaBitCount = layout.alpha;
+      params.order = layout.order;
+      params.byteOrder = layout.byteOrder;
+      params.width = width;
+      return params;
+   }
+
+
+   /// The entry of s_layouts called @a name.
+   const Layout& layoutNamed( const char* name )
+   {
+      size_t   i( 0 );
+
+      while ( i + 1 < sizeof( s_layouts ) / sizeof( s_layouts[0] ) && strcmp( s_layouts[i].name, name ) != 0 )
+         ++i;
+      Q_ASSERT( strcmp( s_layouts[i].name, name ) == 0 );
+      return s_layouts[i];
+   }
+
+
+   /// Fills @a filename with @a size bytes of pseudo-random data.
+   bool writeSyntheticFile( const QString& filename, qint64 size )
+   {
+      QFile       file( filename );
+      QByteArray  chunk;
+      quint64     state( Q_UINT64_C( 0x9e3779b97f4a7c15 ) );
+
+      if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+         return false;
+
+      chunk.resize( int( MB ) );
+      for ( qint64 written = 0; written < size; written += chunk.size() )
+      {
+         quint64*   words( reinterpret_cast< quint64* >( chunk.data() ) );
+
+         // xorshift64
+         for ( int i = 0; i < chunk.size() / 8; ++i )
+         {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            words[i] = state;
+         }
+         if ( file.write( chunk.constData(), qMin( qint64( chunk.size() ), size - written ) ) < 0 )
+            return false;
+      }
+      return true;
+   }
+
+
+   void report( QTextStream& out, qint64 sizeMb, const QString& stage,
+                qint64 bytes, quint64 pixels, qint64 ms )
+   {
+      const double   seconds( qMax( ms, qint64( 1 ) ) / 1000.0 );
+
+      out << QString( "%1 MB  %2 %3 MB/s %4 Mpixel/s" )
+                .arg( sizeMb, 5 )
+                .arg( stage, -18 )
+                .arg( bytes / double( MB ) / seconds, 9, 'f', 1 )
+                .arg( pixels / 1e6 / seconds, 9, 'f', 1 )
+          << endl;
+   }
+
+
+   /// Runs every stage on a file of @a sizeMb MB; returns false on failure.
+   bool benchSize( QTextStream& out, const QString& dir, qint64 sizeMb,
+                   unsigned int width, int threads )
+   {
+      const QString  source( QDir( dir ).filePath( QString( "lpbench_%1.bin" ).arg( sizeMb ) ) );
+      const QString  output( QDir( dir ).filePath( "lpbench_out.tiff" ) );
+      const qint64   bytes( sizeMb * MB );
+      LP::Imager     imager;
+      QElapsedTimer  timer;
+      bool           ok( false );
+
+      imager.setThreadCount( threads );
+
+      if ( ! writeSyntheticFile( source, bytes ) )
+      {
+         QTextStream( stderr ) << "Can't write " << source << endl;
+         QFile::remove( source );
+         return false;
+      }
+
+      timer.start();
+      if ( imager.load( source ) )
+      {
+         report( out, sizeMb, "load", bytes, 0, timer.elapsed() );
+         ok = true;
+
+         for ( size_t i = 0; ok && i < sizeof( s_layouts ) / sizeof( s_layouts[0] ); ++i )
+         {
+            const LP::Imager::RenderParams   params( paramsFor( s_layouts[i], width ) );
+
+            timer.restart();
+            ok = imager.decodeAll( params );
+            report( out, sizeMb, QString( "decode " ) + s_layouts[i].name, bytes,
+                    imager.rowCount( params ) * width, timer.elapsed() );
+         }
+
+         const LP::Imager::RenderParams   params( paramsFor( layoutNamed( s_exportLayout ), width ) );
+         const char* const                names[] = { "export none", "export deflate", "export lzw" };
+
+         for ( int c = LP::TiffWriter::NoCompression; ok && c <= LP::TiffWriter::Lzw; ++c )
+         {
+            LP::Exporter   exporter( imager, params );
+
+            exporter.setSingleImage( true );
+            exporter.setCompression( LP::TiffWriter::Compression( c ) );
+
+            timer.restart();
+            ok = exporter.run( output );
+            report( out, sizeMb, names[c], bytes, imager.rowCount( params ) * width, timer.elapsed() );
+            QFile::remove( output );
+         }
+      }
+
+      if ( ! ok )
+         QTextStream( stderr ) << "Benchmark of " << source << " failed" << endl;
+
+      QFile::remove( source );
+      return ok;
+   }
+}
+
+
+
+int main( int argc, char* argv[] )
+{
+   QCoreApplication  app( argc, argv );
+   QStringList       args( app.arguments() );
+   qint64            maxSizeMb( s_sizes[ sizeof( s_sizes ) / sizeof( s_sizes[0] ) - 1 ] );
+   unsigned int      width( 1024 );
+   int               threads( 0 );
+   QString           dir( QDir::tempPath() );
+
+   for ( int i = 1; i < args.size(); i += 2 )
+   {
+      const QString  value( i + 1 < args.size() ? args[i + 1] : QString() );
+
+      if ( value.isEmpty() )
+         args[i] = "--help";
+
+      if ( args[i] == "--max-size" )
+         maxSizeMb = value.toLongLong();
+      else if ( args[i] == "--width" )
+         width = qBound( 1u, value.toUInt(), MaxWidth );
+      else if ( args[i] == "--threads" )
+         threads = value.toInt();
+      else if ( args[i] == "--dir" )
+         dir = value;
+      else
+      {
+         QTextStream( stderr ) << "Usage: " << args[0]
+                               << " [--max-size MB] [--width N] [--threads N] [--dir DIR]" << endl;
+         return 2;
+      }
+   }
+
+   QTextStream out( stdout );
+   int         failures( 0 );
+
+   for ( size_t i = 0; i < sizeof( s_sizes ) / sizeof( s_sizes[0] ) && s_sizes[i] <= maxSizeMb; ++i )
+   {
+      if ( ! benchSize( out, dir, s_sizes[i], width, threads ) )
+         ++failures;
+   }
+
+   return failures > 0 ? 1 : 0;
+}
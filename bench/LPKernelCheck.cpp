@@ -0,0 +1,220 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+/* Checks the vector row kernels against the scalar ones, bit for bit:
+
+      LoomPreviewKernelCheck
+
+   For gray 8, 5/6/5 in RGB and BGR order, 8/8/8 in every order and
+   8/8/8/8 with the alpha byte first or last, in either byte order, the
+   vector kernel at each instruction set level this CPU supports must give
+   exactly the pixels (and leave the reader exactly where) the scalar
+   kernel does, for every width from 0 to MaxWidth, for rows starting on
+   and off a byte boundary and for rows that end at or run past the end of
+   the data.  Each mismatch is printed; the exit code is 1 if there were
+   any.
+*/
+
+#include "LPBitReader.h"
+#include "LPImager.h"
+#include "LPPixelDecoders.h"
+#include "LPSimdRows.h"
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <stdio.h>
+#include <vector>
+
+
+namespace
+{
+   /// Widest row tried; wide enough for several full AVX2 vectors plus a tail.
+   const unsigned int   MaxWidth( 130 );
+
+   /// Untouched output pixels, to catch kernels writing past the row.
+   const QRgb           Guard( 0x12345678u );
+   const unsigned int   GuardPixels( 8 );
+
+   struct Layout
+   {
+      const char*                name;
+      unsigned int               red, green, blue, gray, alpha;
+      LP::Imager::ChannelOrder   order;
+      bool                       alphaFirst;
+      LP::Imager::ByteOrder      byteOrder;
+      LP::Imager::BitOrder       bitOrder;
+   };
+
+   /// Every layout with a vector kernel.
+   const Layout   s_layouts[] =
+   {
+      { "gray 8",        0, 0, 0, 8, 0, LP::Imager::Grayscale, false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "rgb 5/6/5",     5, 6, 5, 0, 0, LP::Imager::RGB,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "bgr 5/6/5",     5, 6, 5, 0, 0, LP::Imager::BGR,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "rgb 8/8/8",     8, 8, 8, 0, 0, LP::Imager::RGB,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "rbg 8/8/8",     8, 8, 8, 0, 0, LP::Imager::RBG,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "gbr 8/8/8",     8, 8, 8, 0, 0, LP::Imager::GBR,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "grb 8/8/8",     8, 8, 8, 0, 0, LP::Imager::GRB,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "bgr 8/8/8",     8, 8, 8, 0, 0, LP::Imager::BGR,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "brg 8/8/8",     8, 8, 8, 0, 0, LP::Imager::BRG,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "rgba 8/8/8/8",  8, 8, 8, 0, 8, LP::Imager::RGB,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "bgra 8/8/8/8",  8, 8, 8, 0, 8, LP::Imager::BGR,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "argb 8/8/8/8",  8, 8, 8, 0, 8, LP::Imager::RGB,       true,  LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "abgr 8/8/8/8",  8, 8, 8, 0, 8, LP::Imager::BGR,       true,  LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "gbra 8/8/8/8",  8, 8, 8, 0, 8, LP::Imager::GBR,       false, LP::Imager::BigEndian,     LP::Imager::MsbFirst },
+      { "rgba le",       8, 8, 8, 0, 8, LP::Imager::RGB,       false, LP::Imager::LittleEndian,  LP::Imager::MsbFirst },
+      { "argb le",       8, 8, 8, 0, 8, LP::Imager::RGB,       true,  LP::Imager::LittleEndian,  LP::Imager::MsbFirst },
+      { "bgra lsb",      8, 8, 8, 0, 8, LP::Imager::BGR,       false, LP::Imager::BigEndian,     LP::Imager::LsbFirst }
+   };
+
+   const char* const s_levelNames[] = { "none", "SSE2", "SSSE3", "AVX2" };
+
+
+   LP::Imager::RenderParams paramsFor( const Layout& layout, unsigned int width )
+   {
+      LP::Imager::RenderParams   params;
+
+      params.redBitCount = layout.red;
+      params.greenBitCount = layout.green;
+      params.blueBitCount = layout.blue;
+      params.grayBitCount = layout.gray;
+      params.alphaBitCount = layout.alpha;
+      params.order = layout.order;
+      params.alphaFirst = layout.alphaFirst;
+      params.byteOrder = layout.byteOrder;
+      params.bitOrder = layout.bitOrder;
+      params.width = width;
+      return params;
+   }
+
+
+   /// Returns @a size bytes of pseudo-random data.
+   std::vector< uchar > syntheticData( size_t size )
+   {
+      std::vector< uchar > data( size );
+      quint64              state( Q_UINT64_C( 0x9e3779b97f4a7c15 ) );
+
+      // xorshift64
+      for ( size_t i = 0; i < size; ++i )
+      {
+         state ^= state << 13;
+         state ^= state >> 7;
+         state ^= state << 17;
+         data[i] = uchar( state >> 56 );
+      }
+      return data;
+   }
+
+
+   /**@brief Decodes one row starting at @a startBit with both decoders and
+      reports any difference.  Returns false on a mismatch.
+   */
+   bool checkRow( QTextStream& err, const QString& what, const std::vector< uchar >& data,
+                  quint64 startBit, const LP::PixelLayout& layout,
+                  LP::RowDecoder simd, LP::RowDecoder scalar )
+   {
+      const unsigned int   width( layout.width );
+      std::vector< QRgb >  expected( width + GuardPixels, Guard );
+      std::vector< QRgb >  actual( width + GuardPixels, Guard );
+      const quint64        bitCount( quint64( data.size() ) * 8 );
+      LP::BitReader        expectedBits( &data[0], bitCount, startBit );
+      LP::BitReader        actualBits( &data[0], bitCount, startBit );
+
+      scalar( expectedBits, &expected[0], width, layout );
+      simd( actualBits, &actual[0], width, layout );
+
+      for ( unsigned int x = 0; x < width + GuardPixels; ++x )
+      {
+         if ( actual[x] != expected[x] )
+         {
+            err << what << ", width " << width << ", start bit " << startBit
+                << ": pixel " << x << " is " << QString::number( actual[x], 16 )
+                << ", expected " << QString::number( expected[x], 16 ) << endl;
+            return false;
+         }
+      }
+
+      if ( actualBits.position() != expectedBits.position() )
+      {
+         err << what << ", width " << width << ", start bit " << startBit
+             << ": reader ends at bit " << actualBits.position()
+             << ", expected " << expectedBits.position() << endl;
+         return false;
+      }
+      return true;
+   }
+}
+
+
+
+int main( int argc, char* argv[] )
+{
+   QCoreApplication  app( argc, argv );
+   QTextStream       out( stdout );
+   QTextStream       err( stderr );
+
+   // Big enough for the widest row at every start bit; the rows that run
+   // into the end are placed against it explicitly.
+   const std::vector< uchar > data( syntheticData( 3 * MaxWidth + 64 ) );
+   const quint64              bitCount( quint64( data.size() ) * 8 );
+   const LP::SimdLevel        best( LP::simdLevel() );
+   int                        rows( 0 ), failures( 0 );
+
+   out << "Vector kernels up to " << s_levelNames[ best ] << endl;
+
+   for ( size_t i = 0; i < sizeof( s_layouts ) / sizeof( s_layouts[0] ); ++i )
+   {
+      for ( int level = LP::SimdSSE2; level <= best; ++level )
+      {
+         const QString  what( QString( "%1 %2" ).arg( s_layouts[i].name ).arg( s_levelNames[ level ] ) );
+
+         for ( unsigned int width = 0; width <= MaxWidth; ++width )
+         {
+            const LP::PixelLayout   layout( paramsFor( s_layouts[i], width ) );
+            const LP::RowDecoder    simd( LP::selectSimdRowDecoder( layout, LP::SimdLevel( level ) ) );
+            const LP::RowDecoder    scalar( LP::selectScalarRowDecoder( layout ) );
+            const quint64           rowBits( quint64( width ) * layout.bitsPerPixel() );
+
+            // No kernel for this layout at this level (8/8/8 and 8/8/8/8
+            // need SSSE3).
+            if ( ! simd )
+               break;
+
+            // Aligned, then unaligned starts; then rows ending exactly at
+            // the end of the data, a byte past it and a few bits past it.
+            const quint64  starts[] =
+            {
+               0, 8, 24, 1, 3, 7, 13,
+               bitCount - rowBits, bitCount - rowBits + 8, bitCount - rowBits + 3
+            };
+
+            for ( size_t s = 0; s < sizeof( starts ) / sizeof( starts[0] ); ++s )
+            {
+               ++rows;
+               if ( ! checkRow( err, what, data, starts[s], layout, simd, scalar ) )
+                  ++failures;
+            }
+         }
+      }
+   }
+
+   out << rows << " rows checked, " << failures << " mismatches" << endl;
+   return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+# Times the imaging core on synthetic data; see LPBench.cpp.
+TARGET = LoomPreviewBench
+include(../LoomPreview.pri)
+
+TEMPLATE = app
+
+SOURCES +=  LPBench.cpp 
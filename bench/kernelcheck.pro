@@ -0,0 +1,7 @@
+# Checks the vector row kernels against the scalar ones; see LPKernelCheck.cpp.
+TARGET = LoomPreviewKernelCheck
+include(../LoomPreview.pri)
+
+TEMPLATE = app
+
+SOURCES +=  LPKernelCheck.cpp 
@@ -0,0 +1,450 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPBatch.h"
+#include "LPExporter.h"
+#include "LPPixelDecoders.h"
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+
+#include <map>
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+
+namespace LP
+{
+   namespace
+   {
+      /// Command line names of the channel orders, in Imager::ChannelOrder order.
+      const char* const s_orderNames[] =
+      {
+         "rgb", "rbg", "bgr", "brg", "grb", "gbr", "gray"
+      };
+
+      /// Command line names of the compressions, in TiffWriter::Compression order.
+      const char* const s_compressionNames[] =
+      {
+         "none", "deflate", "lzw"
+      };
+
+      /// Widest row a QImage can hold (its bytes per line are an int).
+      const unsigned int   MaxWidth( INT_MAX / 4 );
+
+
+      /// Returns the index of @a name in @a names, or -1.
+      int indexOf( const char* const* names, int count, const QString& name )
+      {
+         for ( int i = 0; i < count; ++i )
+         {
+            if ( name.compare( names[i], Qt::CaseInsensitive ) == 0 )
+               return i;
+         }
+         return -1;
+      }
+
+
+      /// The TIFF that input @a filename is exported to.
+      QString outputPath( const BatchOptions& options, const QString& filename )
+      {
+         return QDir( options.outputDir ).filePath( QFileInfo( filename ).completeBaseName() + ".tiff" );
+      }
+
+
+      /**@brief Checks that no two input files export to the same TIFF.
+         Jobs run at once, so two of them writing (or abandoning) one file
+         would clobber each other.  Returns false and sets @a error if any
+         do.
+      */
+      bool outputsAreDistinct( const BatchOptions& options, QString& error )
+      {
+         std::map< QString, QString >  inputs;
+
+         for ( int i = 0; i < options.inputFiles.size(); ++i )
+         {
+            const QString  output( QDir::cleanPath( QFileInfo( outputPath( options,
+                                                                  options.inputFiles[i] ) ).absoluteFilePath() ) );
+            const std::map< QString, QString >::const_iterator   other( inputs.find( output ) );
+
+            if ( other != inputs.end() )
+            {
+               error = QObject::tr( "%1 and %2 would both be exported to %3" )
+                          .arg( other->second, options.inputFiles[i] ).arg( output );
+               return false;
+            }
+            inputs[ output ] = options.inputFiles[i];
+         }
+         return true;
+      }
+
+
+      /// Prints the outcome of each file as it finishes and counts failures.
+      class BatchReport
+      {
+      public:
+         BatchReport()
+         : m_out( stdout )
+         , m_err( stderr )
+         { }
+
+         void succeeded( const QString& line )
+         {
+            QMutexLocker   lock( &m_mutex );
+
+            m_out << line << endl;
+         }
+
+         void failed( const QString& filename, const QString& why )
+         {
+            QMutexLocker   lock( &m_mutex );
+
+            m_err << filename << ": " << why << endl;
+            m_failures.ref();
+         }
+
+         int failures() { return m_failures.fetchAndAddRelaxed( 0 ); }
+
+      private:
+         QMutex         m_mutex;
+         QTextStream    m_out, m_err;
+         QAtomicInt     m_failures;
+      };
+
+
+      /// Loads, decodes and (optionally) exports one file.
+      class BatchJob : public QRunnable
+      {
+      public:
+         BatchJob( const BatchOptions& options, const QString& filename, int threads,
+                   BatchReport& report )
+         : m_options( options )
+         , m_filename( filename )
+         , m_threads( threads )
+         , m_report( report )
+         { }
+
+         virtual void run()
+         {
+            Imager         imager;
+            QElapsedTimer  timer;
+
+            imager.setThreadCount( m_threads );
+
+            timer.start();
+            if ( ! imager.load( m_filename ) )
+            {
+               m_report.failed( m_filename, QObject::tr( "could not be read" ) );
+               return;
+            }
+
+            const qint64   loadMs( timer.restart() );
+            const quint64  rows( imager.rowCount( m_options.params ) );
+            QString        what;
+
+            if ( m_options.outputDir.isEmpty() )
+            {
+               what = "decode";
+               if ( ! imager.decodeAll( m_options.params ) )
+               {
+                  m_report.failed( m_filename, QObject::tr( "could not be decoded" ) );
+                  return;
+               }
+            }
+            else
+            {
+               Exporter       exporter( imager, m_options.params );
+               const QString  output( outputPath( m_options, m_filename ) );
+
+               what = "export";
+               exporter.setSingleImage( m_options.singleImage );
+               exporter.setBlockSize( m_options.blockSize );
+               exporter.setCompression( m_options.compression );
+               if ( ! exporter.run( output ) )
+               {
+                  m_report.failed( m_filename, exporter.errorString() );
+                  return;
+               }
+            }
+
+            const qint64   workMs( timer.elapsed() );
+            const double   bytes( double( QFileInfo( m_filename ).size() ) );
+
+            m_report.succeeded( QString( "%1: %2 rows, load %3 ms, %4 %5 ms, %6 MB/s" )
+                                   .arg( m_filename )
+                                   .arg( rows )
+                                   .arg( loadMs )
+                                   .arg( what )
+                                   .arg( workMs )
+                                   .arg( bytes / 1048576.0 / ( qMax( workMs, qint64( 1 ) ) / 1000.0 ),
+                                         0, 'f', 1 ) );
+         }
+
+      private:
+         const BatchOptions&  m_options;
+         QString              m_filename;
+         int                  m_threads;
+         BatchReport&         m_report;
+      };
+   }
+
+
+
+   BatchOptions::BatchOptions()
+   : blockSize( 10 * 1024 * 1024 )
+   , singleImage( false )
+   , compression( TiffWriter::NoCompression )
+   , jobs( 0 )
+   , threadsPerFile( 0 )
+   {
+   }
+
+
+
+   bool Batch::isRequested( int argc, char* argv[] )
+   {
+      for ( int i = 1; i < argc; ++i )
+      {
+         if ( strcmp( argv[i], "--batch" ) == 0 )
+            return true;
+      }
+      return false;
+   }
+
+
+   QString Batch::usage()
+   {
+      return QObject::tr(
+         "Usage: LoomPreview --batch [options] file...\n"
+         "\n"
+         "  --width N              pixels per row (default 500)\n"
+         "  --offset N             bytes to skip at the start of each file\n"
+         "  --offset-bits N        further bits to skip\n"
+         "  --red N, --green N, --blue N, --gray N\n"
+         "                         bits per channel, up to 16 (default 3, 2, 3, 8)\n"
+         "  --order ORDER          rgb, rbg, bgr, brg, grb, gbr or gray\n"
+         "  --alpha N              bits of alpha (or padding) after the channels\n"
+         "  --alpha-first          put the alpha bits before the channels\n"
+         "  --little-endian        swap the bytes of whole-byte pixels\n"
+         "  --lsb-first            pack bits from the low end of each byte\n"
+         "  --planar               store each channel in a plane of its own\n"
+         "  --output DIR           export TIFFs to DIR; otherwise only decode\n"
+         "  --block-size MB        rows per exported image, as data size (default 10)\n"
+         "  --single               export each file as one image\n"
+         "  --compression C        none, deflate or lzw (default none)\n"
+         "  --jobs N               files processed at once (default: one per core)\n"
+         "  --threads N            decoder threads per file (default: cores / jobs)\n" );
+   }
+
+
+   bool Batch::parseArguments( const QStringList& arguments, BatchOptions& options, QString& error )
+   {
+      quint64  offsetBytes( 0 ), offsetBits( 0 );
+
+      for ( int i = 1; i < arguments.size(); ++i )
+      {
+         const QString&    arg( arguments[i] );
+
+         if ( arg == "--batch" )
+            continue;
+         if ( arg == "--single" )
+         {
+            options.singleImage = true;
+            continue;
+         }
+         if ( arg == "--alpha-first" )
+         {
+            options.params.alphaFirst = true;
+            continue;
+         }
+         if ( arg == "--little-endian" )
+         {
+            options.params.byteOrder = Imager::LittleEndian;
+            continue;
+         }
+         if ( arg == "--lsb-first" )
+         {
+            options.params.bitOrder = Imager::LsbFirst;
+            continue;
+         }
+         if ( arg == "--planar" )
+         {
+            options.params.planar = true;
+            continue;
+         }
+         if ( ! arg.startsWith( "--" ) )
+         {
+            options.inputFiles << arg;
+            continue;
+         }
+
+         // Everything else takes a value.
+         if ( i + 1 >= arguments.size() )
+         {
+            error = QObject::tr( "%1 needs a value" ).arg( arg );
+            return false;
+         }
+
+         const QString&    value( arguments[++i] );
+         bool              ok( true );
+
+         if ( arg == "--width" )
+            options.params.width = value.toUInt( &ok );
+         else if ( arg == "--offset" )
+            offsetBytes = value.toULongLong( &ok );
+         else if ( arg == "--offset-bits" )
+            offsetBits = value.toULongLong( &ok );
+         else if ( arg == "--red" )
+            options.params.redBitCount = value.toUInt( &ok );
+         else if ( arg == "--green" )
+            options.params.greenBitCount = value.toUInt( &ok );
+         else if ( arg == "--blue" )
+            options.params.blueBitCount = value.toUInt( &ok );
+         else if ( arg == "--gray" )
+            options.params.grayBitCount = value.toUInt( &ok );
+         else if ( arg == "--alpha" )
+            options.params.alphaBitCount = value.toUInt( &ok );
+         else if ( arg == "--block-size" )
+            options.blockSize = value.toULongLong( &ok ) * 1024 * 1024;
+         else if ( arg == "--output" )
+            options.outputDir = value;
+         else if ( arg == "--jobs" )
+            options.jobs = value.toInt( &ok );
+         else if ( arg == "--threads" )
+            options.threadsPerFile = value.toInt( &ok );
+         else if ( arg == "--order" )
+         {
+            const int   order( indexOf( s_orderNames, int( sizeof( s_orderNames ) / sizeof( s_orderNames[0] ) ), value ) );
+
+            ok = order >= 0;
+            if ( ok )
+               options.params.order = Imager::ChannelOrder( order );
+         }
+         else if ( arg == "--compression" )
+         {
+            const int   compression( indexOf( s_compressionNames,
+                                              int( sizeof( s_compressionNames ) / sizeof( s_compressionNames[0] ) ),
+                                              value ) );
+
+            ok = compression >= 0;
+            if ( ok )
+               options.compression = TiffWriter::Compression( compression );
+         }
+         else
+         {
+            error = QObject::tr( "Unknown option %1" ).arg( arg );
+            return false;
+         }
+
+         if ( ! ok )
+         {
+            error = QObject::tr( "Bad value for %1: %2" ).arg( arg ).arg( value );
+            return false;
+         }
+      }
+
+      options.params.offsetBits = offsetBytes * 8 + offsetBits;
+
+      if ( options.params.width < 1 || options.params.width > MaxWidth ||
+           options.params.redBitCount > PixelLayout::MaxFieldBits ||
+           options.params.greenBitCount > PixelLayout::MaxFieldBits ||
+           options.params.blueBitCount > PixelLayout::MaxFieldBits ||
+           options.params.grayBitCount > PixelLayout::MaxFieldBits ||
+           options.params.alphaBitCount > PixelLayout::MaxFieldBits || options.blockSize == 0 )
+      {
+         error = QObject::tr( "Width, bit counts or block size out of range" );
+         return false;
+      }
+      if ( options.inputFiles.isEmpty() )
+      {
+         error = QObject::tr( "No input files" );
+         return false;
+      }
+      return true;
+   }
+
+
+   int Batch::run( const BatchOptions& options )
+   {
+      QString  error;
+
+      if ( ! options.outputDir.isEmpty() && ! outputsAreDistinct( options, error ) )
+      {
+         QTextStream( stderr ) << error << endl;
+         return 1;
+      }
+
+      if ( ! options.outputDir.isEmpty() && ! QDir().mkpath( options.outputDir ) )
+      {
+         QTextStream( stderr ) << QObject::tr( "Can't create %1" ).arg( options.outputDir ) << endl;
+         return 1;
+      }
+
+      const int   cores( qMax( QThread::idealThreadCount(), 1 ) );
+      const int   jobs( qMin( options.jobs > 0 ? options.jobs : cores, options.inputFiles.size() ) );
+      const int   threads( options.threadsPerFile > 0 ? options.threadsPerFile : qMax( cores / jobs, 1 ) );
+      BatchReport    report;
+      QThreadPool    pool;
+      QElapsedTimer  timer;
+
+      timer.start();
+      pool.setMaxThreadCount( jobs );
+      for ( int i = 0; i < options.inputFiles.size(); ++i )
+         pool.start( new BatchJob( options, options.inputFiles[i], threads, report ) );
+      pool.waitForDone();
+
+      QTextStream( stdout ) << QObject::tr( "%1 files in %2 ms, %3 failed" )
+                                 .arg( options.inputFiles.size() )
+                                 .arg( timer.elapsed() )
+                                 .arg( report.failures() ) << endl;
+
+      return report.failures() > 0 ? 1 : 0;
+   }
+
+
+   int Batch::run( const QStringList& arguments )
+   {
+      BatchOptions   options;
+      QString        error;
+
+      if ( arguments.contains( "--help" ) )
+      {
+         QTextStream( stdout ) << usage();
+         return 0;
+      }
+      if ( ! parseArguments( arguments, options, error ) )
+      {
+         QTextStream( stderr ) << error << "\n\n" << usage();
+         return 2;
+      }
+      return run( options );
+   }
+
+
+}  // namespace LP
@@ -0,0 +1,91 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPBATCH_H
+#define LPBATCH_H
+
+#include "LPImager.h"
+#include "LPTiffWriter.h"
+
+#include <QString>
+#include <QStringList>
+
+
+namespace LP
+{
+
+
+/**@brief What a headless batch run does, as given on the command line. */
+struct BatchOptions
+{
+   BatchOptions();
+
+   /// How every file is interpreted.
+   Imager::RenderParams    params;
+   /// Block size, in bytes, that images are split at when not exporting a
+   /// single image.
+   quint64                 blockSize;
+
+   /// Directory the TIFFs are written to; if empty, files are only
+   /// decoded (for timing).
+   QString                 outputDir;
+   bool                    singleImage;
+   TiffWriter::Compression compression;
+
+   /// Number of files processed at once.
+   int                     jobs;
+   /// Decoder threads per file; 0 shares the cores out between the jobs.
+   int                     threadsPerFile;
+
+   QStringList             inputFiles;
+};
+
+
+/**@brief Headless rendering of many files with one interpretation.
+
+   Runs without a display (only QCoreApplication is needed), so it works
+   on a server or under the offscreen platform.  Each file is loaded,
+   decoded and optionally exported on a pool of jobs, and a line of timings
+   is printed for each as it finishes.
+*/
+namespace Batch
+{
+   /// True if the command line asks for batch mode (contains --batch).
+   bool isRequested( int argc, char* argv[] );
+
+   /**@brief Parses @a arguments (as from QCoreApplication::arguments())
+      into @a options.  Returns false and sets @a error if they don't make
+      sense.
+   */
+   bool parseArguments( const QStringList& arguments, BatchOptions& options, QString& error );
+
+   /// Text describing the command line options.
+   QString usage();
+
+   /// Processes every input file; returns the process exit code.
+   int run( const BatchOptions& options );
+
+   /// Parses @a arguments and runs them; returns the process exit code.
+   int run( const QStringList& arguments );
+}
+
+
+}  // namespace LP
+
+#endif   // LPBATCH_H
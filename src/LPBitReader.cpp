@@ -0,0 +1,58 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "LPBitReader.h"
+
+
+namespace LP
+{
+   namespace
+   {
+      struct ScaleTables
+      {
+         ScaleTables()
+         {
+            for ( int bits = 0; bits <= 8; ++bits )
+            {
+               int   maxVal( ( 1 << bits ) - 1 );
+
+               for ( int v = 0; v < 256; ++v )
+               {
+                  if ( maxVal == 0 || v > maxVal )
+                     table[bits][v] = 0;
+                  else
+                     table[bits][v] = uchar( ( v * 255 + maxVal / 2 ) / maxVal );
+               }
+            }
+         }
+
+         uchar table[9][256];
+      };
+
+      const ScaleTables s_scaleTables;
+   }
+
+
+   const uchar* scaleTable( int bitCount )
+   {
+      Q_ASSERT( bitCount >= 0 && bitCount <= 8 );
+      return s_scaleTables.table[bitCount];
+   }
+
+
+}  // namespace LP
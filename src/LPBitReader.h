@@ -0,0 +1,144 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef LPBITREADER_H
+#define LPBITREADER_H
+
+#include <QtEndian>
+
+
+namespace LP
+{
+
+
+/**@brief Extracts bit fields from a byte buffer a 64-bit word at a time.
+
+   The buffer is treated as one continuous stream of bits, most significant
+   bit of each byte first (or least significant first, with the *Lsb
+   functions).  A field of up to MaxFieldBits bits is pulled out
+   with a single (unaligned) word load and two shifts; only the last few
+   bytes of the buffer need the slower byte-by-byte path.  Bits past the end
+   of the buffer read as zero.
+*/
+class BitReader
+{
+public:
+   /// The widest field that one read() can return.
+   enum { MaxFieldBits = 57 };
+
+   BitReader( const uchar* data, quint64 bitCount, quint64 bitPos = 0 )
+   : m_data( data )
+   , m_bitCount( bitCount )
+   , m_fastEnd( bitCount / 8 >= 8 ? ( bitCount / 8 - 7 ) * 8 : 0 )
+   , m_pos( bitPos )
+   { }
+
+   /// Returns the next @a bitCount (0..MaxFieldBits) bits and advances past them.
+   inline quint64 read( int bitCount )
+   {
+      quint64  val( peek( bitCount ) );
+      m_pos += bitCount;
+      return val;
+   }
+
+   /// Returns the next @a bitCount (0..MaxFieldBits) bits without advancing.
+   inline quint64 peek( int bitCount ) const
+   {
+      if ( bitCount == 0 )
+         return 0;
+
+      return ( word( m_pos ) << ( m_pos % 8 ) ) >> ( 64 - bitCount );
+   }
+
+   /**@brief Like read(), but for streams packed least significant bit of
+      each byte first: the first bit read is the lowest bit of the result.
+   */
+   inline quint64 readLsb( int bitCount )
+   {
+      quint64  val( peekLsb( bitCount ) );
+      m_pos += bitCount;
+      return val;
+   }
+
+   /// Like peek(), for streams packed least significant bit first.
+   inline quint64 peekLsb( int bitCount ) const
+   {
+      if ( bitCount == 0 )
+         return 0;
+
+      return ( qbswap( word( m_pos ) ) >> ( m_pos % 8 ) ) & ( ~quint64( 0 ) >> ( 64 - bitCount ) );
+   }
+
+   /// Skips @a bitCount bits.
+   inline void skip( quint64 bitCount ) { m_pos += bitCount; }
+
+   /// Moves to an absolute bit position.
+   inline void seek( quint64 bitPos ) { m_pos = bitPos; }
+
+   inline quint64 position() const { return m_pos; }
+
+   /// If the reader sits on a byte boundary with at least @a byteCount whole
+   /// bytes left, returns a pointer to them; otherwise returns NULL.
+   inline const uchar* alignedBytes( quint64 byteCount ) const
+   {
+      if ( m_pos % 8 != 0 || m_pos / 8 + byteCount > m_bitCount / 8 )
+         return NULL;
+      return m_data + m_pos / 8;
+   }
+
+private:
+   /// Returns the 8 bytes starting at the byte holding bit @a pos, big-endian.
+   inline quint64 word( quint64 pos ) const
+   {
+      const uchar*   p( m_data + pos / 8 );
+
+      if ( pos < m_fastEnd )
+         return qFromBigEndian< quint64 >( p );
+
+      // Near (or past) the end of the buffer; don't read beyond it.
+      quint64  w( 0 );
+      quint64  byteCount( m_bitCount / 8 );
+
+      for ( int i = 0; i < 8; ++i )
+      {
+         w <<= 8;
+         if ( pos / 8 + i < byteCount )
+            w |= p[i];
+      }
+      return w;
+   }
+
+   const uchar*   m_data;
+   quint64        m_bitCount;
+   /// Bit positions below this can load a full word directly.
+   quint64        m_fastEnd;
+   quint64        m_pos;
+};
+
+
+
+/**@brief Returns a 256-entry table that scales a @a bitCount-bit value
+   (0..8 bits) to the full 0..255 range.  Entries past 2^bitCount are 0.
+*/
+const uchar* scaleTable( int bitCount );
+
+
+}  // namespace LP
+
+#endif   // LPBITREADER_H
+
@@ -0,0 +1,211 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPEntropyMap.h"
+#include "LPProfiler.h"
+
+#include <QMutexLocker>
+#include <QtEndian>
+
+#include <math.h>
+#include <string.h>
+
+
+namespace LP
+{
+   namespace
+   {
+      /// c * log2( c ) for every count a chunk can have, so that the
+      /// entropy of a chunk takes 256 lookups and no logarithms.
+      struct EntropyTables
+      {
+         EntropyTables()
+         {
+            xlog2x[0] = 0;
+            for ( int c = 1; c <= EntropyMap::ChunkBytes; ++c )
+               xlog2x[c] = float( c * log( double( c ) ) / log( 2.0 ) );
+         }
+
+         float xlog2x[ EntropyMap::ChunkBytes + 1 ];
+      };
+
+      const EntropyTables s_entropyTables;
+   }
+
+
+
+   void countBytes( const uchar* data, size_t count, quint32 counts[256] )
+   {
+      // Counting into one table stalls whenever neighbouring bytes are
+      // equal (as they are in padding and flat images): each increment has
+      // to wait for the one before it to be stored.  Four tables, each
+      // taking every fourth byte, keep four independent chains going, and
+      // bytes are fetched eight at a time.
+      quint32  sub[4][256];
+      size_t   i( 0 );
+
+      memset( sub, 0, sizeof( sub ) );
+
+      for ( ; i + 8 <= count; i += 8 )
+      {
+         const quint64  w( qFromLittleEndian< quint64 >( data + i ) );
+
+         ++sub[0][ w & 0xff ];
+         ++sub[1][ ( w >> 8 ) & 0xff ];
+         ++sub[2][ ( w >> 16 ) & 0xff ];
+         ++sub[3][ ( w >> 24 ) & 0xff ];
+         ++sub[0][ ( w >> 32 ) & 0xff ];
+         ++sub[1][ ( w >> 40 ) & 0xff ];
+         ++sub[2][ ( w >> 48 ) & 0xff ];
+         ++sub[3][ w >> 56 ];
+      }
+
+      for ( ; i < count; ++i )
+         ++sub[0][ data[i] ];
+
+      for ( int b = 0; b < 256; ++b )
+         counts[b] += sub[0][b] + sub[1][b] + sub[2][b] + sub[3][b];
+   }
+
+
+
+   float shannonEntropy( const quint32 counts[256], quint32 total )
+   {
+      Q_ASSERT( total <= quint32( EntropyMap::ChunkBytes ) );
+
+      if ( total == 0 )
+         return 0;
+
+      // H = -sum( p log2 p ) with p = c / n, which is log2( n ) - sum( c log2 c ) / n.
+      const float*   xlog2x( s_entropyTables.xlog2x );
+      float          sum( 0 );
+
+      for ( int b = 0; b < 256; ++b )
+         sum += xlog2x[ counts[b] ];
+
+      return qMax( 0.0f, ( xlog2x[total] - sum ) / float( total ) );
+   }
+
+
+
+   EntropyMap::EntropyMap()
+   : m_byteCount( 0 )
+   , m_chunksDone( 0 )
+   , m_histogram( 256, 0 )
+   , m_bytes( 0 )
+   {
+   }
+
+
+   EntropyMap::~EntropyMap()
+   {
+      Profiler::instance().adjustCounter( "entropy map bytes", -m_bytes );
+   }
+
+
+
+   void EntropyMap::reset( quint64 byteCount )
+   {
+      QMutexLocker   lock( &m_mutex );
+      const quint64  chunkCount( ( byteCount + ChunkBytes - 1 ) / ChunkBytes );
+
+      m_byteCount = byteCount;
+      m_chunksDone = 0;
+      m_entropy.assign( size_t( chunkCount ), -1.0f );
+      m_histogram.assign( 256, 0 );
+
+      Profiler::instance().adjustCounter( "entropy map bytes", -m_bytes );
+      m_bytes = qint64( chunkCount * sizeof( float ) );
+      Profiler::instance().adjustCounter( "entropy map bytes", m_bytes );
+   }
+
+
+
+   quint64 EntropyMap::byteCount() const
+   {
+      QMutexLocker   lock( &m_mutex );
+      return m_byteCount;
+   }
+
+
+   quint64 EntropyMap::chunkCount() const
+   {
+      QMutexLocker   lock( &m_mutex );
+      return m_entropy.size();
+   }
+
+
+   quint64 EntropyMap::chunksDone() const
+   {
+      QMutexLocker   lock( &m_mutex );
+      return m_chunksDone;
+   }
+
+
+
+   void EntropyMap::store( quint64 firstChunk, const std::vector< float >& entropies,
+                           const quint64 histogram[256] )
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      Q_ASSERT( firstChunk + entropies.size() <= m_entropy.size() );
+
+      for ( size_t i = 0; i < entropies.size(); ++i )
+         m_entropy[ size_t( firstChunk ) + i ] = entropies[i];
+      for ( int b = 0; b < 256; ++b )
+         m_histogram[b] += histogram[b];
+      m_chunksDone += entropies.size();
+   }
+
+
+
+   float EntropyMap::entropy( quint64 firstByte, quint64 count ) const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      if ( count == 0 || firstByte >= m_byteCount )
+         return -1;
+
+      const quint64  first( firstByte / ChunkBytes );
+      const quint64  last( ( qMin( firstByte + count, m_byteCount ) - 1 ) / ChunkBytes );
+      float          sum( 0 );
+      int            known( 0 );
+
+      for ( quint64 c = first; c <= last; ++c )
+      {
+         if ( m_entropy[ size_t( c ) ] >= 0 )
+         {
+            sum += m_entropy[ size_t( c ) ];
+            ++known;
+         }
+      }
+
+      return known ? sum / known : -1;
+   }
+
+
+
+   std::vector< quint64 > EntropyMap::histogram() const
+   {
+      QMutexLocker   lock( &m_mutex );
+      return m_histogram;
+   }
+
+
+}  // namespace LP
@@ -0,0 +1,99 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPENTROPYMAP_H
+#define LPENTROPYMAP_H
+
+#include <QMutex>
+
+#include <vector>
+
+
+namespace LP
+{
+
+
+/**@brief The Shannon entropy of every chunk of the data, and a histogram
+   of all of its bytes.
+
+   Entropy tells the regions of a file apart at a glance: compressed or
+   encrypted data sits near 8 bits per byte, raw pixels somewhere in the
+   middle and padding near 0.  The chunks are filled in (from any thread,
+   in any order) with store(); the map can be read while that is going on,
+   and chunks not stored yet have no entropy.  The map depends only on the
+   data, not on how it is rendered.
+*/
+class EntropyMap
+{
+public:
+   /// Bytes per chunk; the last chunk may be shorter.
+   enum { ChunkBytes = 4096 };
+
+   EntropyMap();
+   ~EntropyMap();
+
+   /// Starts over for @a byteCount bytes of data.
+   void reset( quint64 byteCount );
+
+   quint64 byteCount() const;
+   quint64 chunkCount() const;
+   /// How many chunks have been stored so far.
+   quint64 chunksDone() const;
+
+   /**@brief Stores the entropies of chunks @a firstChunk onwards, one per
+      element of @a entropies, and adds @a histogram (the byte counts of
+      those chunks) to the whole-data one.
+   */
+   void store( quint64 firstChunk, const std::vector< float >& entropies,
+               const quint64 histogram[256] );
+
+   /**@brief Returns the mean entropy, in bits per byte, of the chunks
+      holding bytes @a firstByte .. @a firstByte + @a count - 1, or -1 if
+      none of them have been stored yet.
+   */
+   float entropy( quint64 firstByte, quint64 count ) const;
+
+   /// Returns how often each byte value occurs in the chunks stored so far.
+   std::vector< quint64 > histogram() const;
+
+private:
+   mutable QMutex          m_mutex;
+
+   quint64                 m_byteCount;
+   quint64                 m_chunksDone;
+   /// Per chunk, or -1 if not stored yet.
+   std::vector< float >    m_entropy;
+   std::vector< quint64 >  m_histogram;
+
+   /// Memory the map takes, as told to the profiler.
+   qint64                  m_bytes;
+};
+
+
+/// Adds how often each byte value occurs in @a data (@a count bytes) to @a counts.
+void countBytes( const uchar* data, size_t count, quint32 counts[256] );
+
+/// Returns the Shannon entropy, in bits per byte, of @a total (at most
+/// EntropyMap::ChunkBytes) bytes with the byte counts @a counts.
+float shannonEntropy( const quint32 counts[256], quint32 total );
+
+
+}  // namespace LP
+
+#endif   // LPENTROPYMAP_H
@@ -0,0 +1,252 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPEntropyStrip.h"
+#include "LPEntropyMap.h"
+#include "LPProfiler.h"
+
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QToolTip>
+
+
+namespace LPUI
+{
+   namespace
+   {
+      /// How long (ms) after a load the build starts, so it doesn't compete
+      /// with the first render.
+      const int   StartDelay( 300 );
+      /// How often (ms) a build in progress is shown.
+      const int   RefreshInterval( 250 );
+      /// Default width of the strip.
+      const int   StripWidth( 16 );
+
+
+      /// Blue for no entropy through green to red for 8 bits per byte.
+      QColor heatColor( float entropy )
+      {
+         return QColor::fromHsv( 240 - int( qBound( 0.0f, entropy, 8.0f ) * 30 ), 255, 255 );
+      }
+   }
+
+
+   /// Builds an entropy map off the GUI thread.
+   class EntropyBuilder : public Worker
+   {
+   public:
+      EntropyBuilder( LP::Imager* imgr, LP::EntropyMap* map )
+         : m_imager( imgr )
+         , m_map( map )
+      { }
+
+      virtual void run()
+      {
+         m_imager->buildEntropyMap( *m_map, cancelFlag() );
+      }
+
+   private:
+      LP::Imager*       m_imager;
+      LP::EntropyMap*   m_map;
+   };
+
+
+
+EntropyStrip::EntropyStrip( QWidget* parent )
+: QWidget( parent )
+, m_imager( NULL )
+, m_map( new LP::EntropyMap() )
+, m_firstRow( 0 )
+, m_top( 0 )
+{
+   setAttribute( Qt::WA_OpaquePaintEvent );
+   setMouseTracking( true );
+   setFixedWidth( StripWidth );
+
+   m_startTimer.setSingleShot( true );
+   m_startTimer.setInterval( StartDelay );
+   m_refreshTimer.setInterval( RefreshInterval );
+
+   connect(&m_startTimer,
+      SIGNAL(timeout()),
+      SLOT(onStartTimeout()));
+
+   connect(&m_refreshTimer,
+      SIGNAL(timeout()),
+      SLOT(onRefreshTimeout()));
+
+   connect(&m_builder,
+      SIGNAL(finished(LPUI::Worker*)),
+      SLOT(onBuilderFinished(LPUI::Worker*)));
+}
+
+
+EntropyStrip::~EntropyStrip()
+{
+   stopBuild();
+   delete m_map;
+}
+
+
+
+QSize EntropyStrip::sizeHint() const
+{
+   return QSize( StripWidth, 256 );
+}
+
+
+
+void EntropyStrip::setSource( LP::Imager* imager, const LP::Imager::RenderParams& params )
+{
+   m_params = params;
+
+   // The map depends only on the data, so it is kept until the data changes.
+   if ( imager != m_imager )
+   {
+      stopBuild();
+      m_map->reset( 0 );
+      m_imager = imager;
+
+      if ( imager )
+         m_startTimer.start();
+   }
+
+   update();
+}
+
+
+
+void EntropyStrip::setView( quint64 firstRow, int top )
+{
+   m_firstRow = firstRow;
+   m_top = top;
+   update();
+}
+
+
+
+void EntropyStrip::stopBuild()
+{
+   m_startTimer.stop();
+   m_refreshTimer.stop();
+   m_builder.stop();
+}
+
+
+
+void EntropyStrip::onStartTimeout()
+{
+   if ( ! m_imager || m_builder.worker() )
+      return;
+
+   // The strip is a nicety; interactive rendering comes first.
+   m_builder.start( new EntropyBuilder( m_imager, m_map ), QThread::LowPriority );
+   m_refreshTimer.start();
+}
+
+
+
+void EntropyStrip::onRefreshTimeout()
+{
+   update();
+}
+
+
+
+void EntropyStrip::onBuilderFinished( LPUI::Worker* )
+{
+   m_refreshTimer.stop();
+   update();
+}
+
+
+
+float EntropyStrip::entropyAt( int y ) const
+{
+   if ( ! m_imager || y < m_top )
+      return -1;
+
+   const quint64  row( m_firstRow + quint64( y - m_top ) );
+   const quint64  rowBits( m_params.rowBits() );
+
+   if ( row >= m_imager->rowCount( m_params ) )
+      return -1;
+
+   // The bytes the row was decoded from (in stream order, for planar data).
+   const quint64  startBit( m_params.offsetBits + row * rowBits );
+
+   return m_map->entropy( startBit / 8, qMax( quint64( 1 ), rowBits / 8 ) );
+}
+
+
+
+void EntropyStrip::paintEvent( QPaintEvent* event )
+{
+   LP::ScopedTimer   timer( "paint entropy strip" );
+   QPainter painter( this );
+   const QRect       area( event->rect() );
+
+   painter.fillRect( area, palette().dark() );
+
+   for ( int y = area.top(); y <= area.bottom(); ++y )
+   {
+      const float entropy( entropyAt( y ) );
+
+      if ( entropy >= 0 )
+         painter.fillRect( 0, y, width(), 1, heatColor( entropy ) );
+   }
+}
+
+
+
+void EntropyStrip::mouseMoveEvent( QMouseEvent* event )
+{
+   const float entropy( entropyAt( event->y() ) );
+
+   if ( entropy < 0 )
+   {
+      QToolTip::hideText();
+      return;
+   }
+
+   // The most common byte of the whole file says what the padding is.
+   const std::vector< quint64 >  histogram( m_map->histogram() );
+   quint64                       total( 0 );
+   int                           common( 0 );
+
+   for ( int b = 0; b < 256; ++b )
+   {
+      total += histogram[b];
+      if ( histogram[b] > histogram[ common ] )
+         common = b;
+   }
+
+   QString  text( tr( "%1 bits per byte" ).arg( double( entropy ), 0, 'f', 2 ) );
+
+   if ( total > 0 )
+      text += tr( "\nMost common byte: 0x%1 (%2%)" )
+              .arg( uint( common ), 2, 16, QChar( '0' ) )
+              .arg( 100.0 * double( histogram[ common ] ) / double( total ), 0, 'f', 1 );
+
+   QToolTip::showText( event->globalPos(), text, this );
+}
+
+
+}  // namespace LPUI
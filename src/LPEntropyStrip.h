@@ -0,0 +1,114 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPENTROPYSTRIP_H
+#define LPENTROPYSTRIP_H
+
+#include "LPImager.h"
+#include "LPWorker.h"
+
+#include <QTimer>
+#include <QWidget>
+
+
+namespace LP
+{
+class EntropyMap;
+}
+
+
+namespace LPUI
+{
+
+
+/**@brief A heat-map strip beside the preview showing how random the data
+   behind each preview row is.
+
+   Each pixel row of the strip is coloured by the entropy of the data the
+   preview row level with it was decoded from, from blue (constant bytes)
+   to red (8 bits per byte: compressed or encrypted data).  The entropy of
+   the whole data is worked out once per file, in the background, and
+   fills in as it goes; changing the render parameters only moves where
+   the rows fall.  Hovering shows the value and the file's most common
+   byte.
+*/
+class EntropyStrip : public QWidget
+{
+   Q_OBJECT
+
+public:
+   /// Standard constructor
+   EntropyStrip( QWidget* parent = 0 );
+   /// Standard destructor
+   virtual ~EntropyStrip();
+
+   /**@brief Shows the entropy of the data of @a imager rendered with
+      @a params, or nothing if @a imager is NULL.
+
+      The previous Imager is no longer used once this returns, so it may
+      then be deleted.
+   */
+   void setSource( LP::Imager* imager, const LP::Imager::RenderParams& params );
+
+   /// Lines the strip up with the preview: preview row @a firstRow is
+   /// level with strip height @a top.
+   void setView( quint64 firstRow, int top );
+
+   /**@brief Override of base function. */
+   virtual QSize sizeHint() const;
+
+protected:
+   /**@brief Override of base function. */
+   virtual void paintEvent( QPaintEvent* event );
+   /**@brief Override of base function. */
+   virtual void mouseMoveEvent( QMouseEvent* event );
+
+private slots:
+   void onStartTimeout();
+   void onRefreshTimeout();
+   void onBuilderFinished( LPUI::Worker* worker );
+
+private:
+   /// Stops (and throws away) the build in progress, if any.
+   void stopBuild();
+
+   /// The entropy of the data behind the preview row at strip height
+   /// @a y, or -1 if there is no such row or it isn't known yet.
+   float entropyAt( int y ) const;
+
+   LP::Imager*                m_imager;
+   LP::Imager::RenderParams   m_params;
+
+   LP::EntropyMap*   m_map;
+   /// Runs the build in progress, if any.
+   WorkerOwner       m_builder;
+
+   /// Delays a build until loading settles.
+   QTimer            m_startTimer;
+   /// Repaints now and then while a build is in progress.
+   QTimer            m_refreshTimer;
+
+   quint64           m_firstRow;
+   int               m_top;
+};
+
+
+}  // namespace LPUI
+
+#endif   // LPENTROPYSTRIP_H
@@ -0,0 +1,170 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPExporter.h"
+#include "LPProfiler.h"
+
+#include <QFileInfo>
+#include <QImage>
+#include <QThreadPool>
+
+
+namespace LP
+{
+   namespace
+   {
+      /// Roughly how many bytes of TIFF samples make one strip.
+      const unsigned int   StripBytes( 1024 * 1024 );
+
+      /// Source bytes per image until setBlockSize says otherwise.
+      const quint64        DefaultBlockSize( 10 * 1024 * 1024 );
+   }
+
+
+
+   Exporter::Exporter( Imager& imager, const Imager::RenderParams& params )
+   : m_imager( imager )
+   , m_params( params )
+   , m_rowCount( imager.rowCount( params ) )
+   , m_blockRows( 0 )
+   , m_single( false )
+   , m_compression( TiffWriter::NoCompression )
+   {
+      setBlockSize( DefaultBlockSize );
+   }
+
+
+   void Exporter::setBlockSize( quint64 bytes )
+   {
+      const quint64  rowBits( m_params.rowBits() );
+
+      // A block smaller than a row still gets a row.
+      m_blockRows = rowBits > 0 ? qMax( bytes * 8 / rowBits, quint64( 1 ) ) : 0;
+   }
+
+
+   int Exporter::imageCount() const
+   {
+      if ( m_single )
+         return m_rowCount > 0 ? 1 : 0;
+      if ( m_blockRows == 0 )
+         return 0;
+      return int( ( m_rowCount + m_blockRows - 1 ) / m_blockRows );
+   }
+
+
+   QString Exporter::imageFilename( const QString& filename, int index ) const
+   {
+      if ( m_single )
+         return filename;
+
+      QFileInfo   fi( filename );
+
+      return fi.absolutePath() + "/" + fi.completeBaseName() +
+             QString::number( index + 1 ) + "_of_" + QString::number( imageCount() ) + "." +
+             fi.suffix();
+   }
+
+
+   bool Exporter::run( const QString& filename )
+   {
+      ScopedTimer          timer( "export" );
+      const int            images( imageCount() );
+      const quint64        imageRows( m_single ? m_rowCount : m_blockRows );
+      const unsigned int   stripRows( qMax( 1u, StripBytes / ( m_params.width * 3 ) ) );
+      // Enough strips per batch to keep every pool thread compressing.
+      const unsigned int   batchRows( stripRows * uint( qMax( 1, QThreadPool::globalInstance()->maxThreadCount() ) ) );
+      int                  stripCount( 0 );
+
+      m_error.clear();
+
+      if ( imageRows > 0xffffffffu )
+      {
+         m_error = tr( "The image is too tall to be saved as a single TIFF." );
+         return false;
+      }
+
+      if ( images == 0 )
+      {
+         m_error = tr( "There are no rows to export at this offset and width." );
+         return false;
+      }
+
+      for ( int i = 0; i < images; ++i )
+      {
+         const quint64  rows( qMin( imageRows, m_rowCount - i * imageRows ) );
+
+         stripCount += int( ( rows + stripRows - 1 ) / stripRows );
+      }
+
+      // One batch buffer serves the whole export.
+      QImage   batch( m_params.width, int( qMin( quint64( batchRows ), imageRows ) ),
+                      QImage::Format_RGB32 );
+      int      stripsDone( 0 );
+
+      emit progress( 0, stripCount );
+
+      for ( int i = 0; i < images; ++i )
+      {
+         const quint64  firstRow( i * imageRows );
+         const quint64  rows( qMin( imageRows, m_rowCount - firstRow ) );
+         TiffWriter     writer;
+
+         if ( ! writer.open( imageFilename( filename, i ), m_params.width, uint( rows ), stripRows,
+                             m_compression ) )
+         {
+            m_error = writer.errorString();
+            return false;
+         }
+
+         for ( quint64 row = 0; row < rows; row += batchRows )
+         {
+            const int   n( int( qMin( quint64( batchRows ), rows - row ) ) );
+
+            if ( ! m_imager.decodeRows( m_params, firstRow + row, batch, n, &m_cancel ) )
+               return false;
+
+            if ( ! writer.writeRows( batch, n ) )
+            {
+               m_error = writer.errorString();
+               return false;
+            }
+
+            stripsDone += int( ( n + stripRows - 1 ) / stripRows );
+            emit progress( stripsDone, stripCount );
+         }
+
+         if ( ! writer.close() )
+         {
+            m_error = writer.errorString();
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+
+   void Exporter::cancel()
+   {
+      m_cancel.fetchAndStoreOrdered( 1 );
+   }
+
+
+}  // namespace LP
@@ -0,0 +1,104 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPEXPORTER_H
+#define LPEXPORTER_H
+
+#include "LPImager.h"
+#include "LPTiffWriter.h"
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QString>
+
+
+namespace LP
+{
+
+
+/**@brief Saves the data as TIFF images, streaming each image from the
+   decoder to the file a batch of strips at a time.
+
+   By default the rows are split into one image per block of source data
+   (see setBlockSize()), as earlier versions did; setSingleImage() writes
+   all of the rows as one continuous image instead.  Only one batch of strips (one
+   per pool thread) is ever held in memory, so exporting takes the same
+   (small) amount of memory whatever the size of the data.
+*/
+class Exporter : public QObject
+{
+   Q_OBJECT
+
+public:
+   /// Exports the data of @a imager rendered with @a params.
+   Exporter( Imager& imager, const Imager::RenderParams& params );
+
+   /// Writes every row to one image (a BigTIFF if need be) instead of one
+   /// image per block.
+   void setSingleImage( bool single ) { m_single = single; }
+
+   /// Makes each image (but the last) hold the rows of @a bytes bytes of
+   /// source data, when not writing a single image.  The default is 10 MB.
+   void setBlockSize( quint64 bytes );
+
+   /// Compresses the strips of every image with @a compression.
+   void setCompression( TiffWriter::Compression compression ) { m_compression = compression; }
+
+   /// Number of files run() writes.
+   int imageCount() const;
+
+   /// Returns the name of image @a index (counting from 0) for base name
+   /// @a filename, e.g. "out.tiff" becomes "out2_of_3.tiff".  A single
+   /// image keeps @a filename as it is.
+   QString imageFilename( const QString& filename, int index ) const;
+
+   /**@brief Writes every image, named as imageFilename() says.
+
+      Emits progress() after every batch of strips.  Returns false if there is no
+      row to export, a file can't be written (see errorString()) or the export
+      is cancelled; the file being written then is removed.
+   */
+   bool run( const QString& filename );
+
+   const QString& errorString() const { return m_error; }
+
+public slots:
+   /// Makes run() give up as soon as possible; safe from any thread.
+   void cancel();
+
+signals:
+   void progress( int cur, int goal );
+
+private:
+   Imager&                 m_imager;
+   Imager::RenderParams    m_params;
+   quint64                 m_rowCount;
+   quint64                 m_blockRows;
+   bool                    m_single;
+   TiffWriter::Compression m_compression;
+
+   QAtomicInt              m_cancel;
+   QString                 m_error;
+};
+
+
+}  // namespace LP
+
+#endif   // LPEXPORTER_H
+
@@ -0,0 +1,285 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPHexInspector.h"
+
+#include <QColor>
+#include <QFont>
+#include <QFontMetrics>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QWheelEvent>
+
+
+namespace LPUI
+{
+   namespace
+   {
+      /// Bytes shown on each line.
+      const int   BytesPerLine( 4 );
+      /// Lines of text above the bytes.
+      const int   HeaderLines( 2 );
+      /// Hex digits of the offset at the start of each line.
+      const int   OffsetDigits( 10 );
+      /// Space around the text, in pixels.
+      const int   Margin( 4 );
+      /// Lines the wheel scrolls per step.
+      const int   WheelLines( 3 );
+
+      /// Where the hex and the binary columns start, in characters.
+      const int   HexColumn( OffsetDigits + 2 );
+      const int   BitsColumn( HexColumn + BytesPerLine * 3 + 1 );
+
+
+      /// Background of the bits of @a channel (see LP::Imager::SourceBit).
+      QColor channelColor( char channel )
+      {
+         switch ( channel )
+         {
+         case 'R':   return QColor( 255, 170, 170 );
+         case 'G':   return QColor( 170, 230, 170 );
+         case 'B':   return QColor( 170, 190, 255 );
+         case 'A':   return QColor( 240, 220, 150 );
+         default:    return QColor( 210, 210, 210 );
+         }
+      }
+   }
+
+
+
+HexInspector::HexInspector( QWidget* parent )
+: QWidget( parent )
+, m_imager( NULL )
+, m_hasPixel( false )
+, m_row( 0 )
+, m_column( 0 )
+, m_topLine( 0 )
+{
+   QFont mono( "Monospace" );
+
+   mono.setStyleHint( QFont::TypeWriter );
+   setFont( mono );
+   setAttribute( Qt::WA_OpaquePaintEvent );
+}
+
+
+
+void HexInspector::setSource( LP::Imager* imager, const LP::Imager::RenderParams& params )
+{
+   if ( imager != m_imager )
+   {
+      m_hasPixel = false;
+      m_topLine = 0;
+   }
+
+   m_imager = imager;
+   m_params = params;
+   updatePixel();
+   update();
+}
+
+
+
+QSize HexInspector::sizeHint() const
+{
+   const QFontMetrics   metrics( font() );
+
+   return QSize( 2 * Margin + ( BitsColumn + BytesPerLine * 9 ) * metrics.width( '0' ),
+                 2 * Margin + ( HeaderLines + 16 ) * metrics.height() );
+}
+
+
+
+void HexInspector::showPixel( quint64 row, unsigned int column )
+{
+   if ( m_hasPixel && row == m_row && column == m_column )
+      return;
+
+   m_hasPixel = true;
+   m_row = row;
+   m_column = column;
+   updatePixel();
+   update();
+}
+
+
+
+void HexInspector::updatePixel()
+{
+   m_bits.clear();
+   m_position.clear();
+   m_values.clear();
+
+   if ( ! m_imager || ! m_hasPixel )
+      return;
+
+   m_bits = m_imager->pixelBits( m_params, m_row, m_column );
+   if ( m_bits.empty() )
+      return;
+
+   quint64  firstByte( m_bits[0].byte );
+   quint64  lastByte( m_bits[0].byte );
+
+   for ( size_t i = 0; i < m_bits.size(); ++i )
+   {
+      firstByte = qMin( firstByte, m_bits[i].byte );
+      lastByte = qMax( lastByte, m_bits[i].byte );
+   }
+
+   m_position = tr("Row %1, column %2: bytes %3-%4")
+                .arg( m_row ).arg( m_column ).arg( firstByte ).arg( lastByte );
+
+   // Each run of bits of one channel is one field, most significant bit
+   // first.  The bytes are read one at a time, since a planar pixel's
+   // fields are far apart.
+   for ( size_t i = 0; i < m_bits.size(); )
+   {
+      const char     channel( m_bits[i].channel );
+      quint64        value( 0 );
+      unsigned int   bitCount( 0 );
+
+      for ( ; i < m_bits.size() && m_bits[i].channel == channel; ++i, ++bitCount )
+      {
+         const QByteArray  byte( m_imager->bytes( m_bits[i].byte, 1 ) );
+
+         value = ( value << 1 ) | ( byte.isEmpty() ? 0 : ( uchar( byte[0] ) >> m_bits[i].bit ) & 1 );
+      }
+
+      m_values += tr("%1 %2 (%3 bits)  ").arg( QChar( channel ) ).arg( value ).arg( bitCount );
+   }
+
+   // Follow the pixel, but leave the view alone while it stays in sight.
+   const quint64  line( firstByte / BytesPerLine );
+   const quint64  lines( visibleLines() );
+
+   if ( line < m_topLine || line >= m_topLine + lines )
+      m_topLine = line > lines / 3 ? line - lines / 3 : 0;
+   clampTopLine();
+}
+
+
+
+int HexInspector::visibleLines() const
+{
+   const QFontMetrics   metrics( font() );
+
+   return qMax( 1, ( height() - 2 * Margin ) / metrics.height() - HeaderLines );
+}
+
+
+
+void HexInspector::clampTopLine()
+{
+   const quint64  byteCount( m_imager ? m_imager->dataBitCount() / 8 : 0 );
+   const quint64  lineCount( ( byteCount + BytesPerLine - 1 ) / BytesPerLine );
+   const quint64  lines( visibleLines() );
+
+   if ( m_topLine + lines > lineCount )
+      m_topLine = lineCount > lines ? lineCount - lines : 0;
+}
+
+
+
+void HexInspector::paintEvent( QPaintEvent* event )
+{
+   QPainter             painter( this );
+   const QFontMetrics   metrics( font() );
+   const int            lineHeight( metrics.height() );
+   const int            charWidth( metrics.width( '0' ) );
+
+   painter.fillRect( event->rect(), palette().base() );
+   painter.setPen( palette().color( QPalette::Text ) );
+
+   if ( ! m_imager )
+      return;
+
+   painter.drawText( Margin, Margin + metrics.ascent(), m_position );
+   painter.drawText( Margin, Margin + lineHeight + metrics.ascent(), m_values );
+
+   // Only the lines on screen are read from the data.
+   const quint64     firstByte( m_topLine * BytesPerLine );
+   const QByteArray  data( m_imager->bytes( firstByte, visibleLines() * BytesPerLine ) );
+   // The channel each bit on screen feeds (0 for none), most significant
+   // bit of each byte first.
+   QByteArray        channels( data.size() * 8, 0 );
+
+   for ( size_t i = 0; i < m_bits.size(); ++i )
+   {
+      if ( m_bits[i].byte >= firstByte && m_bits[i].byte < firstByte + data.size() )
+         channels[ int( m_bits[i].byte - firstByte ) * 8 + 7 - int( m_bits[i].bit ) ] = m_bits[i].channel;
+   }
+
+   for ( int line = 0; line * BytesPerLine < data.size(); ++line )
+   {
+      const int   top( Margin + ( HeaderLines + line ) * lineHeight );
+      QString     hex;
+      QString     bits;
+
+      for ( int i = 0; i < BytesPerLine && line * BytesPerLine + i < data.size(); ++i )
+      {
+         const int   index( line * BytesPerLine + i );
+         const uchar byte( data[ index ] );
+
+         hex += QString( "%1 " ).arg( uint( byte ), 2, 16, QChar( '0' ) );
+         bits += QString( "%1 " ).arg( uint( byte ), 8, 2, QChar( '0' ) );
+
+         // Colour each bit the pixel uses, and its byte in the hex column
+         // after the channel of its first such bit.
+         char  used( 0 );
+
+         for ( int b = 0; b < 8; ++b )
+         {
+            const char  channel( channels[ index * 8 + b ] );
+
+            if ( channel )
+            {
+               painter.fillRect( Margin + ( BitsColumn + i * 9 + b ) * charWidth, top,
+                                 charWidth, lineHeight, channelColor( channel ) );
+               if ( ! used )
+                  used = channel;
+            }
+         }
+
+         if ( used )
+            painter.fillRect( Margin + ( HexColumn + i * 3 ) * charWidth, top,
+                              2 * charWidth, lineHeight, channelColor( used ) );
+      }
+
+      painter.drawText( Margin, top + metrics.ascent(),
+                        QString( "%1  " ).arg( firstByte + line * BytesPerLine, OffsetDigits, 16, QChar( '0' ) ) +
+                        hex.leftJustified( BytesPerLine * 3 + 1 ) + bits );
+   }
+}
+
+
+
+void HexInspector::wheelEvent( QWheelEvent* event )
+{
+   if ( event->delta() > 0 )
+      m_topLine = m_topLine > quint64( WheelLines ) ? m_topLine - WheelLines : 0;
+   else
+      m_topLine += WheelLines;
+
+   clampTopLine();
+   update();
+   event->accept();
+}
+
+
+}  // namespace LPUI
@@ -0,0 +1,102 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPHEXINSPECTOR_H
+#define LPHEXINSPECTOR_H
+
+#include "LPImager.h"
+
+#include <QString>
+#include <QWidget>
+
+#include <vector>
+
+
+namespace LPUI
+{
+
+
+/**@brief Shows the bytes and bits that a pixel of the preview is decoded
+   from.
+
+   The bytes around the pixel are shown in hex and in binary, with every
+   bit the pixel uses coloured by the channel it feeds, and the value of
+   each channel is listed above them.  Only the lines on screen are read,
+   straight from the Imager's data, so the size of the file doesn't
+   matter.  The view follows the pixel shown; the wheel scrolls it.
+*/
+class HexInspector : public QWidget
+{
+   Q_OBJECT
+
+public:
+   /// Standard constructor
+   HexInspector( QWidget* parent = 0 );
+
+   /**@brief Shows the data of @a imager as decoded with @a params, or
+      nothing if @a imager is NULL.
+
+      The previous Imager is no longer used once this returns, so it may
+      then be deleted.
+   */
+   void setSource( LP::Imager* imager, const LP::Imager::RenderParams& params );
+
+   /**@brief Override of base function. */
+   virtual QSize sizeHint() const;
+
+public slots:
+   /// Shows the bits of the pixel at @a row, @a column.
+   void showPixel( quint64 row, unsigned int column );
+
+protected:
+   /**@brief Override of base function. */
+   virtual void paintEvent( QPaintEvent* event );
+   /**@brief Override of base function. */
+   virtual void wheelEvent( QWheelEvent* event );
+
+private:
+   /// Works out the bits and channel values of the current pixel and
+   /// scrolls to them if they are out of view.
+   void updatePixel();
+
+   /// Number of lines of bytes that fit below the header.
+   int visibleLines() const;
+
+   /// Keeps m_topLine within the data.
+   void clampTopLine();
+
+   LP::Imager*                m_imager;
+   LP::Imager::RenderParams   m_params;
+
+   bool                       m_hasPixel;
+   quint64                    m_row;
+   unsigned int               m_column;
+   std::vector< LP::Imager::SourceBit >   m_bits;
+   /// The pixel's position and channel values, shown above the bytes.
+   QString                    m_position;
+   QString                    m_values;
+
+   /// The first line of bytes shown.
+   quint64                    m_topLine;
+};
+
+
+}  // namespace LPUI
+
+#endif   // LPHEXINSPECTOR_H
@@ -0,0 +1,336 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPHypothesisGrid.h"
+
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QPixmap>
+#include <QRegExp>
+#include <QStringList>
+#include <QVBoxLayout>
+
+#include <algorithm>
+
+
+namespace LPUI
+{
+   namespace
+   {
+      /// How long (ms) the parameters must stay put before a render starts.
+      const int            StartDelay( 300 );
+      /// Rows rendered for each hypothesis (two tiles).
+      const unsigned int   HypothesisRows( 512 );
+      /// Largest side of a thumbnail, in pixels.
+      const int            ThumbnailSize( 160 );
+
+      /// A channel layout worth trying on unknown data.
+      struct CommonLayout
+      {
+         unsigned int               redBits, greenBits, blueBits, grayBits, alphaBits;
+         LP::Imager::ChannelOrder   order;
+         LP::Imager::ByteOrder      byteOrder;
+      };
+
+      const CommonLayout   s_commonLayouts[] =
+      {
+         { 0, 0, 0, 8, 0, LP::Imager::Grayscale, LP::Imager::BigEndian },
+         { 0, 0, 0, 16, 0, LP::Imager::Grayscale, LP::Imager::LittleEndian },
+         { 3, 3, 2, 0, 0, LP::Imager::RGB, LP::Imager::BigEndian },
+         { 5, 6, 5, 0, 0, LP::Imager::RGB, LP::Imager::BigEndian },
+         { 5, 6, 5, 0, 0, LP::Imager::BGR, LP::Imager::BigEndian },
+         { 8, 8, 8, 0, 0, LP::Imager::RGB, LP::Imager::BigEndian },
+         { 8, 8, 8, 0, 0, LP::Imager::BGR, LP::Imager::BigEndian },
+         { 8, 8, 8, 0, 8, LP::Imager::RGB, LP::Imager::BigEndian }
+      };
+
+
+      /// @a params with the channel layout @a layout; only the bit counts
+      /// that @a layout uses are changed, and the packing is reset to its.
+      LP::Imager::RenderParams withLayout( LP::Imager::RenderParams params, const CommonLayout& layout )
+      {
+         params.order = layout.order;
+         params.alphaBitCount = layout.alphaBits;
+         params.alphaFirst = false;
+         params.byteOrder = layout.byteOrder;
+         params.bitOrder = LP::Imager::MsbFirst;
+         params.planar = false;
+         if ( layout.order == LP::Imager::Grayscale )
+            params.grayBitCount = layout.grayBits;
+         else
+         {
+            params.redBitCount = layout.redBits;
+            params.greenBitCount = layout.greenBits;
+            params.blueBitCount = layout.blueBits;
+         }
+         return params;
+      }
+
+
+      /// Adds @a value to @a values unless it is there already.
+      template< class T >
+      void addUnique( std::vector< T >& values, const T& value )
+      {
+         if ( std::find( values.begin(), values.end(), value ) == values.end() )
+            values.push_back( value );
+      }
+   }
+
+
+   /// Renders every hypothesis off the GUI thread and shrinks it to a
+   /// thumbnail.
+   class HypothesisRenderer : public Worker
+   {
+   public:
+      HypothesisRenderer( LP::Imager* imgr, const std::vector< LP::Imager::RenderParams >& paramSets )
+         : m_imager( imgr )
+         , m_paramSets( paramSets )
+      { }
+
+      virtual void run()
+      {
+         std::vector< QImage* >  images;
+
+         if ( ! m_imager->renderRows( m_paramSets, 0, HypothesisRows, images, cancelFlag() ) )
+            return;
+
+         m_thumbnails.resize( images.size() );
+         for ( size_t i = 0; i < images.size(); ++i )
+         {
+            if ( images[i] && ! isCancelled() )
+               m_thumbnails[i] = images[i]->scaled( ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio,
+                                                    Qt::SmoothTransformation );
+            m_imager->recycle( images[i] );
+         }
+      }
+
+      const std::vector< LP::Imager::RenderParams >& paramSets() const { return m_paramSets; }
+      /// One per parameter set (null where it has no rows), or none if cancelled.
+      const std::vector< QImage >& thumbnails() const { return m_thumbnails; }
+
+   private:
+      LP::Imager*                               m_imager;
+      std::vector< LP::Imager::RenderParams >   m_paramSets;
+      std::vector< QImage >                     m_thumbnails;
+   };
+
+
+
+HypothesisGrid::HypothesisGrid( QWidget* parent )
+: QWidget( parent )
+, m_imager( NULL )
+, m_maxWidth( 0xffffffffu )
+, m_stale( false )
+, m_widthsEdit( new QLineEdit( this ) )
+, m_list( new QListWidget( this ) )
+{
+   QVBoxLayout*   layout( new QVBoxLayout( this ) );
+   QHBoxLayout*   widthsLayout( new QHBoxLayout() );
+
+   widthsLayout->addWidget( new QLabel( tr("Widths:"), this ) );
+   widthsLayout->addWidget( m_widthsEdit );
+   layout->addLayout( widthsLayout );
+   layout->addWidget( m_list );
+
+   m_widthsEdit->setToolTip( tr("Widths to try, e.g. \"320 640 1280\"; "
+                                "blank for half, once and twice the current width") );
+
+   m_list->setViewMode( QListView::IconMode );
+   m_list->setIconSize( QSize( ThumbnailSize, ThumbnailSize ) );
+   m_list->setResizeMode( QListView::Adjust );
+   m_list->setMovement( QListView::Static );
+   m_list->setUniformItemSizes( true );
+
+   m_startTimer.setSingleShot( true );
+   m_startTimer.setInterval( StartDelay );
+
+   connect(&m_startTimer,
+      SIGNAL(timeout()),
+      SLOT(onStartTimeout()));
+
+   connect(m_widthsEdit,
+      SIGNAL(editingFinished()),
+      SLOT(onWidthsEdited()));
+
+   connect(m_list,
+      SIGNAL(itemClicked(QListWidgetItem*)),
+      SLOT(onItemClicked(QListWidgetItem*)));
+
+   connect(&m_renderer,
+      SIGNAL(finished(LPUI::Worker*)),
+      SLOT(onRendererFinished(LPUI::Worker*)));
+}
+
+
+HypothesisGrid::~HypothesisGrid()
+{
+   stopRender();
+}
+
+
+
+void HypothesisGrid::setSource( LP::Imager* imager, const LP::Imager::RenderParams& params )
+{
+   if ( imager == m_imager && params == m_params )
+      return;
+
+   stopRender();
+
+   // Thumbnails of another file must not stay clickable while the new ones render.
+   if ( imager != m_imager )
+   {
+      m_shown.clear();
+      m_list->clear();
+   }
+
+   m_imager = imager;
+   m_params = params;
+
+   if ( imager )
+      m_startTimer.start();
+}
+
+
+
+void HypothesisGrid::showEvent( QShowEvent* event )
+{
+   QWidget::showEvent( event );
+
+   if ( m_stale )
+      m_startTimer.start();
+}
+
+
+
+void HypothesisGrid::stopRender()
+{
+   m_startTimer.stop();
+   m_renderer.stop();
+}
+
+
+
+std::vector< LP::Imager::RenderParams > HypothesisGrid::hypotheses() const
+{
+   std::vector< unsigned int >   widths;
+   const QStringList             typed( m_widthsEdit->text().split( QRegExp( "[\\s,]+" ),
+                                                                     QString::SkipEmptyParts ) );
+
+   for ( int i = 0; i < typed.size(); ++i )
+   {
+      const unsigned int   w( typed[i].toUInt() );
+
+      if ( w > 0 && w <= m_maxWidth )
+         addUnique( widths, w );
+   }
+
+   if ( widths.empty() )
+   {
+      const unsigned int   candidates[] = { m_params.width / 2, m_params.width, m_params.width * 2 };
+
+      for ( int i = 0; i < 3; ++i )
+      {
+         if ( candidates[i] > 0 && candidates[i] <= m_maxWidth )
+            addUnique( widths, candidates[i] );
+      }
+   }
+
+   // The current layout comes first, then the common ones.
+   std::vector< LP::Imager::RenderParams >   layouts( 1, m_params );
+   std::vector< LP::Imager::RenderParams >   sets;
+
+   for ( size_t i = 0; i < sizeof( s_commonLayouts ) / sizeof( s_commonLayouts[0] ); ++i )
+      addUnique( layouts, withLayout( m_params, s_commonLayouts[i] ) );
+
+   for ( size_t i = 0; i < layouts.size(); ++i )
+   {
+      for ( size_t j = 0; j < widths.size(); ++j )
+      {
+         LP::Imager::RenderParams   params( layouts[i] );
+
+         params.width = widths[j];
+         sets.push_back( params );
+      }
+   }
+
+   return sets;
+}
+
+
+
+void HypothesisGrid::onStartTimeout()
+{
+   if ( ! m_imager || m_renderer.worker() )
+      return;
+
+   // Rendering what nobody sees would only crowd the tile cache.
+   m_stale = ! isVisible();
+   if ( m_stale )
+      return;
+
+   // The preview comes first.
+   m_renderer.start( new HypothesisRenderer( m_imager, hypotheses() ), QThread::LowPriority );
+}
+
+
+
+void HypothesisGrid::onRendererFinished( LPUI::Worker* worker )
+{
+   const HypothesisRenderer*     renderer( static_cast< HypothesisRenderer* >( worker ) );
+   const std::vector< QImage >&  thumbnails( renderer->thumbnails() );
+
+   m_shown.clear();
+   m_list->clear();
+   for ( size_t i = 0; i < thumbnails.size(); ++i )
+   {
+      const LP::Imager::RenderParams&  params( renderer->paramSets()[i] );
+
+      if ( thumbnails[i].isNull() )
+         continue;
+
+      m_list->addItem( new QListWidgetItem( QIcon( QPixmap::fromImage( thumbnails[i] ) ),
+                                            tr("%1 wide, %2").arg( params.width )
+                                                             .arg( params.layoutName() ) ) );
+      m_shown.push_back( params );
+   }
+}
+
+
+
+void HypothesisGrid::onItemClicked( QListWidgetItem* item )
+{
+   const int   row( m_list->row( item ) );
+
+   if ( row >= 0 && size_t( row ) < m_shown.size() )
+      emit hypothesisChosen( m_shown[ row ] );
+}
+
+
+
+void HypothesisGrid::onWidthsEdited()
+{
+   stopRender();
+   if ( m_imager )
+      m_startTimer.start();
+}
+
+
+}  // namespace LPUI
@@ -0,0 +1,114 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPHYPOTHESISGRID_H
+#define LPHYPOTHESISGRID_H
+
+#include "LPImager.h"
+#include "LPWorker.h"
+
+#include <QImage>
+#include <QTimer>
+#include <QWidget>
+
+#include <vector>
+
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+
+
+namespace LPUI
+{
+
+
+/**@brief Shows the start of the data under many interpretations at once.
+
+   Every combination of a few widths (typed in, or by default half, once
+   and twice the current width) and a set of common channel layouts is
+   rendered as a thumbnail.  All of them are decoded together in the
+   background (see LP::Imager::renderRows()) once the parameters stop
+   changing, and only while the grid is visible.  Clicking a thumbnail
+   applies its parameters.
+*/
+class HypothesisGrid : public QWidget
+{
+   Q_OBJECT
+
+public:
+   /// Standard constructor
+   HypothesisGrid( QWidget* parent = 0 );
+   /// Standard destructor
+   virtual ~HypothesisGrid();
+
+   /**@brief Renders hypotheses around @a params from the data of
+      @a imager, or shows nothing if @a imager is NULL.
+
+      The previous Imager is no longer used once this returns, so it may
+      then be deleted.
+   */
+   void setSource( LP::Imager* imager, const LP::Imager::RenderParams& params );
+
+   /// The widest rows tried.
+   void setMaxWidth( unsigned int maxWidth ) { m_maxWidth = maxWidth; }
+
+signals:
+   /// Emitted when the user picks a hypothesis, with its render parameters.
+   void hypothesisChosen( const LP::Imager::RenderParams& params );
+
+protected:
+   /**@brief Override of base function. */
+   virtual void showEvent( QShowEvent* event );
+
+private slots:
+   void onStartTimeout();
+   void onRendererFinished( LPUI::Worker* worker );
+   void onItemClicked( QListWidgetItem* item );
+   /// Starts over with the widths just typed in.
+   void onWidthsEdited();
+
+private:
+   /// Stops (and throws away) the render in progress, if any.
+   void stopRender();
+
+   /// The parameter sets to show, around m_params.
+   std::vector< LP::Imager::RenderParams > hypotheses() const;
+
+   LP::Imager*                m_imager;
+   LP::Imager::RenderParams   m_params;
+   unsigned int               m_maxWidth;
+
+   /// Runs the render in progress, if any.
+   WorkerOwner                m_renderer;
+   /// Delays a render until the parameters settle.
+   QTimer                     m_startTimer;
+   /// Set when the parameters changed while the grid was hidden.
+   bool                       m_stale;
+
+   /// What each item of m_list shows.
+   std::vector< LP::Imager::RenderParams >   m_shown;
+
+   QLineEdit*     m_widthsEdit;
+   QListWidget*   m_list;
+};
+
+
+}  // namespace LPUI
+
+#endif   // LPHYPOTHESISGRID_H
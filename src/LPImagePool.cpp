@@ -0,0 +1,107 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPImagePool.h"
+#include "LPProfiler.h"
+
+#include <QMutexLocker>
+
+
+namespace LP
+{
+
+
+   ImagePool::ImagePool( qint64 budget )
+   : m_bytes( 0 )
+   , m_budget( budget )
+   {
+   }
+
+
+   ImagePool::~ImagePool()
+   {
+      clear();
+   }
+
+
+   QImage ImagePool::acquire( int width, int height )
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      // The most recently freed images are the likeliest to be asked for
+      // again, and the likeliest to still be in the CPU caches.
+      for ( size_t i = m_free.size(); i-- > 0; )
+      {
+         if ( m_free[i].width() == width && m_free[i].height() == height )
+         {
+            QImage   image( m_free[i] );
+
+            m_free.erase( m_free.begin() + i );
+            m_bytes -= image.byteCount();
+            Profiler::instance().adjustCounter( "image pool bytes", -image.byteCount() );
+            return image;
+         }
+      }
+
+      lock.unlock();
+      return QImage( width, height, QImage::Format_RGB32 );
+   }
+
+
+   void ImagePool::release( QImage& image )
+   {
+      // Pixels still shared with another image would be copied as soon as
+      // either was written to, so there is nothing to gain from them.
+      if ( image.isNull() || ! image.isDetached() || image.format() != QImage::Format_RGB32 ||
+           image.byteCount() > m_budget )
+      {
+         image = QImage();
+         return;
+      }
+
+      QMutexLocker   lock( &m_mutex );
+
+      m_free.push_back( image );
+      image = QImage();
+      m_bytes += m_free.back().byteCount();
+      Profiler::instance().adjustCounter( "image pool bytes", m_free.back().byteCount() );
+      trim( m_budget );
+   }
+
+
+   void ImagePool::clear()
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      trim( 0 );
+   }
+
+
+   void ImagePool::trim( qint64 budget )
+   {
+      while ( m_bytes > budget && ! m_free.empty() )
+      {
+         m_bytes -= m_free.front().byteCount();
+         Profiler::instance().adjustCounter( "image pool bytes", -m_free.front().byteCount() );
+         m_free.pop_front();
+      }
+   }
+
+
+}  // namespace LP
@@ -0,0 +1,75 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPIMAGEPOOL_H
+#define LPIMAGEPOOL_H
+
+#include <QImage>
+#include <QMutex>
+
+#include <deque>
+
+
+namespace LP
+{
+
+
+/**@brief Keeps the pixel memory of images that are no longer needed, so
+   that the next image of the same size reuses it rather than allocating
+   (and page-faulting in) fresh memory.
+
+   Renders made over and over at the same size, as when a slider is
+   dragged, then run without allocating.  Free images beyond the memory
+   budget are let go, oldest first.  Safe to use from several threads.
+*/
+class ImagePool
+{
+public:
+   /// Creates a pool that holds on to up to @a budget bytes of free images.
+   ImagePool( qint64 budget );
+   ~ImagePool();
+
+   /// Returns a Format_RGB32 image @a width by @a height pixels, reusing a
+   /// free one if there is one.  Its contents are undefined.
+   QImage acquire( int width, int height );
+
+   /**@brief Takes back the pixels of @a image, which is left null.  Pixels
+      that another image still shares are left alone.
+   */
+   void release( QImage& image );
+
+   /// Lets go of every free image.
+   void clear();
+
+private:
+   /// Drops the oldest free images until they fit in the budget; m_mutex
+   /// must be held.
+   void trim( qint64 budget );
+
+   mutable QMutex       m_mutex;
+   /// Free images, oldest first.
+   std::deque< QImage > m_free;
+   qint64               m_bytes;
+   qint64               m_budget;
+};
+
+
+}  // namespace LP
+
+#endif   // LPIMAGEPOOL_H
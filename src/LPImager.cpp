@@ -16,290 +16,806 @@
 ******************************************************************************/
 
 #include "LPImager.h"
+#include "LPBitReader.h"
+#include "LPEntropyMap.h"
+#include "LPImagePool.h"
+#include "LPOverview.h"
+#include "LPPixelDecoders.h"
+#include "LPProfiler.h"
+#include "LPTileCache.h"
 
-#include <QByteArray>
-#include <QBitArray>
-#include <QFile>
-#include <QFileInfo>
 #include <QImage>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
 
-#include <math.h>
 #include <assert.h>
+#include <limits.h>
+#include <string.h>
 
 namespace LP
 {
-   Imager::Imager()
-   : m_pixelFunc( &LP::Imager::pixelRGB )
-   {
-   }
-   
-   bool Imager::load( const QString& filename, unsigned int blockSize )
+   namespace
    {
-      QFile f( filename );
-      bool  success( false );
+      /// Bands smaller than this aren't worth handing to another thread.
+      const int   MinBandRows( 16 );
 
-      unload();
+      /// How much of an unmappable file is read between progress reports.
+      const qint64   LoadChunkSize( 4 * 1024 * 1024 );
 
-      m_blockSize = blockSize;
+      /// Roughly how many pixels buildOverview decodes at a time.
+      const quint64  OverviewChunkPixels( 1024 * 1024 );
 
-      if ( f.open( QIODevice::ReadOnly ) )
-      {
-         QFileInfo   fi( f );
-         QByteArray  ba;
-         qint64      fileSize( fi.size() );
-         int         bytesToRead( m_blockSize );
+      /// Roughly how many bytes of pixels decodeAll decodes at a time.
+      const quint64  DecodeAllBytes( 4 * 1024 * 1024 );
 
-         for ( qint64 offset = 0; offset < fileSize; offset+=m_blockSize )
-         {
-            if ( offset + m_blockSize > fileSize )
-               bytesToRead = fileSize - offset;
-            ba = f.read( bytesToRead );
+      /// Bytes of data one buildEntropyMap task covers.
+      const quint64  EntropyTaskBytes( 4 * 1024 * 1024 );
+
+      /// Tile cache budget until setCacheBudget says otherwise.
+      const qint64   DefaultCacheBudget( 256 * 1024 * 1024 );
+
+      /// Most memory kept in free images for reuse.
+      const qint64   ImagePoolBudget( 64 * 1024 * 1024 );
 
-            //emit progress( offset / m_blockSize, fileSize / m_blockSize );
 
-            QBitArray*  bits( new QBitArray( bytesToRead * 8 ) );
+      /// Decodes a band of consecutive rows of one image.
+      class BandDecoder : public QRunnable
+      {
+      public:
+         BandDecoder( const uchar* data, quint64 dataBitCount, quint64 startBit,
+                      quint64 rowBits, RowDecoder decodeRow, const PixelLayout& layout,
+                      uchar* dst, int bytesPerLine, unsigned int width, int rowCount,
+                      QAtomicInt* cancel )
+         : m_data( data )
+         , m_dataBitCount( dataBitCount )
+         , m_startBit( startBit )
+         , m_rowBits( rowBits )
+         , m_decodeRow( decodeRow )
+         , m_layout( layout )
+         , m_dst( dst )
+         , m_bytesPerLine( bytesPerLine )
+         , m_width( width )
+         , m_rowCount( rowCount )
+         , m_done( NULL )
+         , m_cancel( cancel )
+         { }
+
+         virtual void run()
+         {
+            BitReader   bits( m_data, m_dataBitCount, m_startBit );
 
-            for ( int i = 0; i < ba.size(); ++i )
+            for ( int j = 0; j < m_rowCount; ++j )
             {
-               unsigned int byte( ba[i] );
+               if ( m_cancel && m_cancel->fetchAndAddRelaxed( 0 ) )
+                  break;
 
-               for ( int j = 0; j < 8; ++j )
-                  bits->setBit( i * 8 + j, ( byte >> j ) & 1 );
+               bits.seek( m_startBit + j * m_rowBits );
+               m_decodeRow( bits, reinterpret_cast< QRgb* >( m_dst + j * m_bytesPerLine ),
+                            m_width, m_layout );
             }
-            assert( bits->size() == bytesToRead * 8 );
-            m_bitArrayVec.push_back( bits );
+
+            if ( m_done )
+               m_done->release();
          }
-         //emit progress( fileSize / m_blockSize, fileSize / m_blockSize );
-         success = true;
-         f.close();
-      }
 
-      return success;
-   }
+         /// Makes the band signal @a done when it has finished.
+         void setDone( QSemaphore* done ) { m_done = done; }
+
+      private:
+         const uchar*   m_data;
+         quint64        m_dataBitCount;
+         quint64        m_startBit;
+         quint64        m_rowBits;
+         RowDecoder     m_decodeRow;
+         PixelLayout    m_layout;
+         uchar*         m_dst;
+         int            m_bytesPerLine;
+         unsigned int   m_width;
+         int            m_rowCount;
+         QSemaphore*    m_done;
+         QAtomicInt*    m_cancel;
+      };
+
+
+      /// Works out the entropies of a run of chunks of the data.
+      class EntropyCounter : public QRunnable
+      {
+      public:
+         EntropyCounter( const uchar* data, quint64 byteCount, quint64 firstChunk,
+                         quint64 chunkCount, EntropyMap& map, QAtomicInt* cancel )
+         : m_data( data )
+         , m_byteCount( byteCount )
+         , m_firstChunk( firstChunk )
+         , m_chunkCount( chunkCount )
+         , m_map( map )
+         , m_done( NULL )
+         , m_cancel( cancel )
+         { }
+
+         virtual void run()
+         {
+            std::vector< float > entropies;
+            quint64              histogram[256];
+            quint32              counts[256];
 
+            entropies.reserve( size_t( m_chunkCount ) );
+            memset( histogram, 0, sizeof( histogram ) );
 
-   Imager::~Imager()
-   {
-      unload();
-   }
+            for ( quint64 c = m_firstChunk; c < m_firstChunk + m_chunkCount; ++c )
+            {
+               if ( m_cancel && m_cancel->fetchAndAddRelaxed( 0 ) )
+                  break;
+
+               const quint64  start( c * EntropyMap::ChunkBytes );
+               const quint32  size( quint32( qMin( quint64( EntropyMap::ChunkBytes ),
+                                                   m_byteCount - start ) ) );
+
+               memset( counts, 0, sizeof( counts ) );
+               countBytes( m_data + start, size, counts );
+               entropies.push_back( shannonEntropy( counts, size ) );
+               for ( int b = 0; b < 256; ++b )
+                  histogram[b] += counts[b];
+            }
 
+            // One store per task keeps the map's lock out of the inner loop.
+            m_map.store( m_firstChunk, entropies, histogram );
 
-   void Imager::regenerate( unsigned int redBitCount,
-                    unsigned int greenBitCount,
-                    unsigned int blueBitCount,
-                    unsigned int grayBitCount,
-                    ChannelOrder order,
-                    unsigned int width,
-                    unsigned int offset,
-                    std::vector< QImage* >& imgVec
-                  )
-   {
-      m_redBitCount = redBitCount;
-      m_greenBitCount = greenBitCount;
-      m_blueBitCount = blueBitCount;
-      m_grayBitCount = grayBitCount;
-     
-      m_bitsPerPixel = m_redBitCount + m_greenBitCount + m_blueBitCount;
-
-      if ( m_bitsPerPixel < 1 )
-         m_bitsPerPixel = m_redBitCount = 1;
-
-      if ( order == RGB )
-         m_pixelFunc = &LP::Imager::pixelRGB;
-      else if ( order == RBG ) 
-         m_pixelFunc = &LP::Imager::pixelRBG;
-      else if ( order == GBR )
-         m_pixelFunc = &LP::Imager::pixelGBR;
-      else if ( order == GRB )
-         m_pixelFunc = &LP::Imager::pixelGRB;
-      else if ( order == BRG )
-         m_pixelFunc = &LP::Imager::pixelBRG;
-      else if ( order == BGR )
-         m_pixelFunc = &LP::Imager::pixelBGR;
-      else if ( order == Grayscale )
+            if ( m_done )
+               m_done->release();
+         }
+
+         /// Makes the task signal @a done when it has finished.
+         void setDone( QSemaphore* done ) { m_done = done; }
+
+      private:
+         const uchar*   m_data;
+         quint64        m_byteCount;
+         quint64        m_firstChunk;
+         quint64        m_chunkCount;
+         EntropyMap&    m_map;
+         QSemaphore*    m_done;
+         QAtomicInt*    m_cancel;
+      };
+
+
+      /// Rows per band for @a totalRows rows spread over @a threads threads.
+      int bandRowCount( quint64 totalRows, int threads )
       {
-         m_pixelFunc = &LP::Imager::pixelGray;
-         m_bitsPerPixel = m_grayBitCount;
-         if ( m_bitsPerPixel < 1 )
-            m_bitsPerPixel = m_grayBitCount = 1;
+         // Enough bands to keep every thread busy even if some finish
+         // early, but none so small that handing one over costs more than
+         // decoding it.
+         return int( qMin( quint64( INT_MAX ), qMax( quint64( MinBandRows ),
+                     ( totalRows + threads * 4 - 1 ) / ( threads * 4 ) ) ) );
       }
 
-      BitArraySizeType bai = 0;
 
-      // Skip bytes as dictated by offset
-      if ( offset > 0 )
+      /// Cuts @a dst_img into bands of @a bandRows rows decoded from @a startBit on.
+      void addBands( std::vector< BandDecoder* >& bands, QImage* dst_img,
+                     const uchar* data, quint64 dataBitCount,
+                     quint64 startBit, quint64 rowBits, int bandRows,
+                     RowDecoder decodeRow, const PixelLayout& layout,
+                     QAtomicInt* cancel )
       {
-         while ( bai < m_bitArrayVec.size() && offset > m_bitArrayVec[bai]->size() / 8 )
+         const int   height( dst_img->height() );
+
+         for ( int j = 0; j < height; j += bandRows )
          {
-            offset -= m_bitArrayVec[bai]->size() / 8;
-            ++bai;
+            bands.push_back( new BandDecoder( data, dataBitCount, startBit + j * rowBits,
+                                              rowBits, decodeRow, layout,
+                                              dst_img->bits() + j * dst_img->bytesPerLine(),
+                                              dst_img->bytesPerLine(), dst_img->width(),
+                                              qMin( bandRows, height - j ), cancel ) );
          }
       }
 
-      unsigned int    i, j, di, limit;
 
-      di = offset * 8;
+      /**@brief The parameters the tiles of @a params are cached under: the
+         offset is cut back to less than a row, and @a rowShift is set to
+         the rows that takes off.  Offsets a whole number of rows apart
+         then share their tiles.  Planes are placed from the offset, so a
+         planar layout keeps its own.
+      */
+      Imager::RenderParams tileParams( const Imager::RenderParams& params, quint64& rowShift )
+      {
+         Imager::RenderParams   phase( params );
+         const quint64          rowBits( params.rowBits() );
+
+         rowShift = 0;
+         if ( ! params.planar && rowBits > 0 )
+         {
+            rowShift = params.offsetBits / rowBits;
+            phase.offsetBits = params.offsetBits % rowBits;
+         }
+         return phase;
+      }
+
 
-      while ( bai < m_bitArrayVec.size() )
+      /// The tiles that one parameter set of a render is assembled from.
+      struct TileRun
       {
-         int height( m_blockSize * 8 / ( width * m_bitsPerPixel ) );
+         TileRun() : firstRow( 0 ), firstTile( 0 ), height( 0 ), sameAs( -1 ) { }
+
+         /// The parameters the tiles are cached under (see tileParams).
+         Imager::RenderParams    params;
+         /// The first row of the result, counted as params counts rows.
+         quint64                 firstRow;
+         quint64                 firstTile;
+         /// Rows of the result; 0 if there are none.
+         int                     height;
+         std::vector< QImage >   tiles;
+         /// Index of an earlier, identical set to copy instead, or -1.
+         int                     sameAs;
+      };
+
+
+      /// Copies the rows of @a run into one @a width wide image from @a pool.
+      QImage* assembleRows( const TileRun& run, unsigned int width, ImagePool& pool )
+      {
+         // Tiles and result have the same width and format, hence the same
+         // scanline layout, so each tile's share is one block copy.
+         QImage*  dst_img( new QImage( pool.acquire( width, run.height ) ) );
+         int      y( 0 );
+
+         for ( size_t i = 0; i < run.tiles.size(); ++i )
+         {
+            const quint64  tileFirstRow( ( run.firstTile + i ) * TileCache::TileRows );
+            const int      skip( int( run.firstRow + y - tileFirstRow ) );
+            const int      rows( qMin( run.tiles[i].height() - skip, run.height - y ) );
+
+            memcpy( dst_img->bits() + y * dst_img->bytesPerLine(),
+                    run.tiles[i].constBits() + skip * run.tiles[i].bytesPerLine(),
+                    size_t( rows ) * dst_img->bytesPerLine() );
+            y += rows;
+         }
+
+         return dst_img;
+      }
 
-         if ( bai == m_bitArrayVec.size() - 1 )
+
+      /// Runs (and deletes) @a bands, returning once all are done.  Works
+      /// for any QRunnable with a setDone() like BandDecoder's.
+      template< class Band >
+      void runBands( const std::vector< Band* >& bands, QThreadPool& pool )
+      {
+         // Once the starting bit of a row is known, rows can be decoded in
+         // any order, so the bands are spread across the thread pool.  Each
+         // band writes only its own rows, so the result doesn't depend on
+         // scheduling.  The calling thread decodes the first band itself
+         // (or all of them if there is only one thread) while the pool
+         // works on the rest.
+         const size_t   inlineCount( pool.maxThreadCount() > 1 ? 1 : bands.size() );
+         QSemaphore     done;
+
+         for ( size_t i = inlineCount; i < bands.size(); ++i )
          {
-            height =  ( m_bitArrayVec[bai]->size() - di ) / ( width * m_bitsPerPixel );
+            bands[i]->setDone( &done );
+            pool.start( bands[i] );
          }
-         else if ( m_bitArrayVec[bai]->size() - di + m_bitArrayVec[bai+1]->size() < m_blockSize * 8 )
+
+         for ( size_t i = 0; i < inlineCount; ++i )
          {
-            height =  ( m_bitArrayVec[bai]->size() - di + m_bitArrayVec[bai+1]->size() ) / ( width * m_bitsPerPixel );
+            bands[i]->run();
+            delete bands[i];
          }
 
-         if ( height == 0 )
-            return;
+         done.acquire( int( bands.size() - inlineCount ) );
+      }
+   }
+
 
-         i = 0;
-         j = 0;
 
-         limit = m_bitArrayVec[bai]->size();
+   Imager::Imager()
+   : m_data( NULL )
+   , m_dataBitCount( 0 )
+   , m_imagePool( new ImagePool( ImagePoolBudget ) )
+   , m_tileCache( new TileCache( DefaultCacheBudget, m_imagePool ) )
+   {
+      setThreadCount( 0 );
+   }
+
+
+   void Imager::setThreadCount( int threadCount )
+   {
+      if ( threadCount < 1 )
+         threadCount = QThread::idealThreadCount();
+      m_threadPool.setMaxThreadCount( qMax( threadCount, 1 ) );
+   }
 
-         QImage* dst_img( new QImage( width, height, QImage::Format_RGB32 ) );
 
-         while( j < height )
+   int Imager::threadCount() const
+   {
+      return m_threadPool.maxThreadCount();
+   }
+   
+   bool Imager::load( const QString& filename )
+   {
+      ScopedTimer timer( "load" );
+      bool  success( false );
+
+      unload();
+
+      m_loadCancelled.fetchAndStoreOrdered( 0 );
+
+      m_file.setFileName( filename );
+      if ( m_file.open( QIODevice::ReadOnly ) )
+      {
+         qint64   fileSize( m_file.size() );
+
+         emit progress( 0, 1 );
+
+         if ( fileSize > 0 )
          {
-            dst_img->setPixel( i, j, (this->*m_pixelFunc)( di, bai, limit ) ); 
-            if ( ++i == width )
-            {
-               i = 0;
-               ++j;
-            }
+            // Map the file read-only so that nothing is read until rows are
+            // decoded; only fall back to reading it in if that fails.
+            m_data = m_file.map( 0, fileSize );
+            if ( ! m_data )
+               m_data = readAll( fileSize );
          }
 
-         imgVec.push_back( dst_img );
-
-         if ( di >= limit )
-            ++bai;
+         if ( m_data || fileSize == 0 )
+         {
+            m_dataBitCount = quint64( fileSize ) * 8;
+            Profiler::instance().adjustCounter( "source bytes", fileSize );
+            success = true;
+            emit progress( 1, 1 );
+         }
+         else
+            unload();
       }
 
+      return success;
    }
 
 
-
-   void Imager::unload()
+   void Imager::cancelLoad()
    {
-      for( size_t i = 0; i < m_bitArrayVec.size(); ++i )
-         delete m_bitArrayVec[i];
-      m_bitArrayVec.clear();
+      m_loadCancelled.fetchAndStoreOrdered( 1 );
    }
 
 
-   unsigned char Imager::mapBits( int bitCount, unsigned int& di, BitArraySizeType& bai, unsigned int& limit )
+   const uchar* Imager::readAll( qint64 fileSize )
    {
-      if ( ! bitCount )
-         return 0;
+      const int   chunkCount( int( ( fileSize + LoadChunkSize - 1 ) / LoadChunkSize ) );
 
-      float scale( 255.0 / ( pow( 2.0f, bitCount ) - 1 ) );
-      int val( 0 );
+      if ( fileSize > qint64( INT_MAX ) )
+         return NULL;
 
-      while( bitCount-- )
+      m_buffer.resize( int( fileSize ) );
+
+      for ( int chunk = 0; chunk < chunkCount; ++chunk )
       {
-         val *= 2;
-         if ( m_bitArrayVec[bai]->testBit(di++) )
-            val += 1;
+         qint64   offset( chunk * LoadChunkSize );
+         qint64   bytesToRead( qMin( LoadChunkSize, fileSize - offset ) );
 
-         if ( di >= limit )
+         if ( m_loadCancelled.fetchAndAddOrdered( 0 ) ||
+              m_file.read( m_buffer.data() + offset, bytesToRead ) != bytesToRead )
          {
-            di = 0;
-            ++bai;
-            if ( bai >= m_bitArrayVec.size() )
-               return 0;
-
-            limit = m_bitArrayVec[bai]->size();
+            m_buffer.clear();
+            return NULL;
          }
+
+         emit progress( chunk + 1, chunkCount + 1 );
       }
 
-      return val * scale;
+      m_file.close();
+      return reinterpret_cast< const uchar* >( m_buffer.constData() );
+   }
+
+
+   Imager::~Imager()
+   {
+      unload();
+      delete m_tileCache;
+      delete m_imagePool;
    }
 
 
-   uint Imager::pixelRGB( unsigned int& di, BitArraySizeType& bai, unsigned int& limit )
+   void Imager::setCacheBudget( qint64 budget )
    {
-      unsigned char r( mapBits( m_redBitCount, di, bai, limit ) );
-      unsigned char g( mapBits( m_greenBitCount, di, bai, limit ) );
-      unsigned char b( mapBits( m_blueBitCount, di, bai, limit ) );
+      m_tileCache->setBudget( budget );
+   }
+
 
-      return qRgb( r, g, b );
+   Imager::RenderParams::RenderParams()
+   : redBitCount( 3 )
+   , greenBitCount( 2 )
+   , blueBitCount( 3 )
+   , grayBitCount( 8 )
+   , order( RGB )
+   , alphaBitCount( 0 )
+   , alphaFirst( false )
+   , byteOrder( BigEndian )
+   , bitOrder( MsbFirst )
+   , planar( false )
+   , width( 500 )
+   , offsetBits( 0 )
+   {
    }
 
 
+   bool Imager::RenderParams::operator==( const RenderParams& other ) const
+   {
+      return redBitCount == other.redBitCount &&
+             greenBitCount == other.greenBitCount &&
+             blueBitCount == other.blueBitCount &&
+             grayBitCount == other.grayBitCount &&
+             order == other.order &&
+             alphaBitCount == other.alphaBitCount &&
+             alphaFirst == other.alphaFirst &&
+             byteOrder == other.byteOrder &&
+             bitOrder == other.bitOrder &&
+             planar == other.planar &&
+             width == other.width &&
+             offsetBits == other.offsetBits;
+   }
 
 
-   uint Imager::pixelRBG( unsigned int& di, BitArraySizeType& bai, unsigned int& limit )
+   QString Imager::RenderParams::layoutName() const
    {
-      unsigned char r( mapBits( m_redBitCount, di, bai, limit ) );
-      unsigned char b( mapBits( m_blueBitCount, di, bai, limit ) );
-      unsigned char g( mapBits( m_greenBitCount, di, bai, limit ) );
+      static const char* const   orderNames[] = { "RGB", "RBG", "BGR", "BRG", "GRB", "GBR" };
+      QString                    name;
+
+      if ( order == Grayscale )
+         name = QString( "%1-bit gray" ).arg( grayBitCount );
+      else
+         name = QString( "%1/%2/%3" ).arg( redBitCount ).arg( greenBitCount ).arg( blueBitCount );
 
-      return qRgb( r, g, b );
+      if ( alphaBitCount > 0 )
+      {
+         name = alphaFirst ? QString( "%1/%2" ).arg( alphaBitCount ).arg( name ) :
+                             QString( "%1/%2" ).arg( name ).arg( alphaBitCount );
+      }
+
+      if ( order != Grayscale )
+      {
+         const bool  alpha( alphaBitCount > 0 );
+
+         name += QString( alpha && alphaFirst ? " A%1" : alpha ? " %1A" : " %1" ).arg( orderNames[ order ] );
+      }
+
+      if ( byteOrder == LittleEndian )
+         name += " LE";
+      if ( bitOrder == LsbFirst )
+         name += " LSB-first";
+      if ( planar )
+         name += " planar";
+      return name;
    }
 
 
+   quint64 Imager::RenderParams::rowBits() const
+   {
+      return quint64( width ) * PixelLayout( *this ).bitsPerPixel();
+   }
+
+
+   bool Imager::RenderParams::isRowShiftOf( const RenderParams& other, qint64& rowShift ) const
+   {
+      RenderParams   moved( other );
+      const quint64  bits( rowBits() );
+      const quint64  distance( offsetBits > other.offsetBits ? offsetBits - other.offsetBits
+                                                             : other.offsetBits - offsetBits );
+
+      // Planes are placed from the offset, so moving it reshuffles the rows
+      // of a planar layout.
+      moved.offsetBits = offsetBits;
+      if ( moved != *this || planar || bits == 0 || distance % bits != 0 )
+         return false;
+
+      rowShift = offsetBits > other.offsetBits ? qint64( distance / bits ) : -qint64( distance / bits );
+      return true;
+   }
 
 
-   uint Imager::pixelGBR( unsigned int& di, BitArraySizeType& bai, unsigned int& limit )
+   quint64 Imager::rowCount( const RenderParams& params ) const
    {
-      unsigned char g( mapBits( m_greenBitCount, di, bai, limit ) );
-      unsigned char b( mapBits( m_blueBitCount, di, bai, limit ) );
-      unsigned char r( mapBits( m_redBitCount, di, bai, limit ) );
+      const PixelLayout layout( params );
+      const quint64  rowBits( quint64( params.width ) * layout.bitsPerPixel() );
+      const quint64  startBit( params.offsetBits );
 
-      return qRgb( r, g, b );
+      if ( rowBits == 0 || startBit >= m_dataBitCount )
+         return 0;
+      return ( m_dataBitCount - startBit ) / rowBits;
    }
 
 
 
+   bool Imager::decodeRows( const RenderParams& params, quint64 firstRow, QImage& dst,
+                            int rowCount, QAtomicInt* cancel )
+   {
+      ScopedTimer timer( "decode rows" );
+      const PixelLayout layout( params, this->rowCount( params ) );
+      const quint64  rowBits( quint64( params.width ) * layout.bitsPerPixel() );
+
+      if ( rowCount < 0 || rowCount > dst.height() || firstRow + rowCount > this->rowCount( params ) )
+         return false;
+
+      const RowDecoder  decodeRow( selectRowDecoder( layout ) );
+      const int         bandRows( bandRowCount( rowCount, threadCount() ) );
+      std::vector< BandDecoder* >   bands;
 
-   uint Imager::pixelGRB( unsigned int& di, BitArraySizeType& bai, unsigned int& limit )
+      for ( int j = 0; j < rowCount; j += bandRows )
+      {
+         bands.push_back( new BandDecoder( m_data, m_dataBitCount,
+                                           params.offsetBits + ( firstRow + j ) * rowBits,
+                                           rowBits, decodeRow, layout,
+                                           dst.bits() + j * dst.bytesPerLine(), dst.bytesPerLine(),
+                                           params.width, qMin( bandRows, rowCount - j ), cancel ) );
+      }
+      runBands( bands, m_threadPool );
+
+      return ! ( cancel && cancel->fetchAndAddRelaxed( 0 ) );
+   }
+
+
+
+   bool Imager::decodeAll( const RenderParams& params, QAtomicInt* cancel )
    {
-      unsigned char g( mapBits( m_greenBitCount, di, bai, limit ) );
-      unsigned char r( mapBits( m_redBitCount, di, bai, limit ) );
-      unsigned char b( mapBits( m_blueBitCount, di, bai, limit ) );
+      const quint64  rows( rowCount( params ) );
+      const int      chunkRows( int( qBound( quint64( 1 ), DecodeAllBytes / ( quint64( params.width ) * 4 ),
+                                             qMax( rows, quint64( 1 ) ) ) ) );
+      QImage         chunk( params.width, chunkRows, QImage::Format_RGB32 );
+
+      if ( chunk.isNull() )
+         return false;
 
-      return qRgb( r, g, b );
+      for ( quint64 row = 0; row < rows; row += chunkRows )
+      {
+         if ( ! decodeRows( params, row, chunk, int( qMin( quint64( chunkRows ), rows - row ) ), cancel ) )
+            return false;
+      }
+      return true;
    }
 
 
 
+   QImage* Imager::renderRows( const RenderParams& params, quint64 firstRow,
+                               unsigned int rowCount, QAtomicInt* cancel )
+   {
+      const std::vector< RenderParams >   paramSets( 1, params );
+      std::vector< QImage* >              images;
+
+      if ( ! renderRows( paramSets, firstRow, rowCount, images, cancel ) )
+         return NULL;
+      return images[0];
+   }
+
 
-   uint Imager::pixelBGR( unsigned int& di, BitArraySizeType& bai, unsigned int& limit )
+
+   bool Imager::renderRows( const std::vector< RenderParams >& paramSets, quint64 firstRow,
+                            unsigned int rowCount, std::vector< QImage* >& images,
+                            QAtomicInt* cancel )
    {
-      unsigned char b( mapBits( m_blueBitCount, di, bai, limit ) );
-      unsigned char g( mapBits( m_greenBitCount, di, bai, limit ) );
-      unsigned char r( mapBits( m_redBitCount, di, bai, limit ) );
+      ScopedTimer timer( "render rows" );
+      std::vector< TileRun >  runs( paramSets.size() );
+      // Tiles to decode, as (set, index into its tiles).
+      std::vector< std::pair< size_t, size_t > >   missing;
+      quint64                 missingRows( 0 );
+
+      for ( size_t s = 0; s < paramSets.size(); ++s )
+      {
+         const RenderParams&  params( paramSets[s] );
+         TileRun&             run( runs[s] );
+
+         // A set that was already asked for shares the earlier one's tiles.
+         for ( size_t t = 0; t < s && run.sameAs < 0; ++t )
+         {
+            if ( paramSets[t] == params )
+               run.sameAs = int( t );
+         }
+
+         const quint64  totalRows( this->rowCount( params ) );
+
+         if ( run.sameAs >= 0 || firstRow >= totalRows || rowCount == 0 )
+            continue;
+
+         quint64        rowShift;
+
+         run.params = tileParams( params, rowShift );
+         run.firstRow = firstRow + rowShift;
+         run.height = int( qMin( quint64( rowCount ), totalRows - firstRow ) );
+         run.firstTile = run.firstRow / TileCache::TileRows;
+         run.tiles.resize( size_t( ( run.firstRow + run.height - 1 ) / TileCache::TileRows - run.firstTile + 1 ) );
+
+         const quint64  tileRows( totalRows + rowShift );
+
+         for ( size_t i = 0; i < run.tiles.size(); ++i )
+         {
+            const quint64  tileFirstRow( ( run.firstTile + i ) * TileCache::TileRows );
+
+            if ( ! m_tileCache->find( TileCache::Key( run.params, run.firstTile + i ), run.tiles[i] ) )
+            {
+               // Tiles are always decoded whole (the last one may be short),
+               // so that every cached tile is complete.
+               run.tiles[i] = m_imagePool->acquire( params.width,
+                                                    int( qMin( quint64( TileCache::TileRows ),
+                                                               tileRows - tileFirstRow ) ) );
+               missing.push_back( std::make_pair( s, i ) );
+               missingRows += run.tiles[i].height();
+            }
+         }
+      }
 
-      return qRgb( r, g, b );
+      if ( ! missing.empty() )
+      {
+         // The tiles of every set go to the pool together, so that many
+         // small renders still keep every thread busy.
+         ScopedTimer       decodeTimer( "decode tiles" );
+         const int         bandRows( bandRowCount( missingRows, threadCount() ) );
+         std::vector< BandDecoder* >   bands;
+
+         for ( size_t m = 0; m < missing.size(); ++m )
+         {
+            TileRun&             run( runs[ missing[m].first ] );
+            const RenderParams&  params( run.params );
+            const PixelLayout    layout( params, this->rowCount( params ) );
+            const quint64        rowBits( quint64( params.width ) * layout.bitsPerPixel() );
+            const quint64        tile( run.firstTile + missing[m].second );
+
+            addBands( bands, &run.tiles[ missing[m].second ], m_data, m_dataBitCount,
+                      params.offsetBits + tile * TileCache::TileRows * rowBits, rowBits,
+                      bandRows, selectRowDecoder( layout ), layout, cancel );
+         }
+         runBands( bands, m_threadPool );
+
+         if ( cancel && cancel->fetchAndAddRelaxed( 0 ) )
+         {
+            // Renders are cancelled all the time while a slider is dragged.
+            for ( size_t m = 0; m < missing.size(); ++m )
+               m_imagePool->release( runs[ missing[m].first ].tiles[ missing[m].second ] );
+            return false;
+         }
+
+         for ( size_t m = 0; m < missing.size(); ++m )
+         {
+            const TileRun&    run( runs[ missing[m].first ] );
+
+            m_tileCache->insert( TileCache::Key( run.params, run.firstTile + missing[m].second ),
+                                 run.tiles[ missing[m].second ] );
+         }
+      }
+
+      std::vector< QImage* >  rendered( runs.size(), static_cast< QImage* >( NULL ) );
+
+      for ( size_t s = 0; s < runs.size(); ++s )
+      {
+         if ( runs[s].sameAs >= 0 )
+         {
+            if ( rendered[ runs[s].sameAs ] )
+               rendered[s] = new QImage( *rendered[ runs[s].sameAs ] );
+         }
+         else if ( runs[s].height > 0 )
+            rendered[s] = assembleRows( runs[s], paramSets[s].width, *m_imagePool );
+      }
+
+      images.insert( images.end(), rendered.begin(), rendered.end() );
+      return true;
+   }
+
+
+
+   bool Imager::buildOverview( const RenderParams& params, Overview& overview,
+                               QAtomicInt* cancel )
+   {
+      ScopedTimer timer( "build overview" );
+      const PixelLayout layout( params, rowCount( params ) );
+      const RowDecoder  decodeRow( selectRowDecoder( layout ) );
+      const quint64     rowBits( quint64( params.width ) * layout.bitsPerPixel() );
+      const quint64     totalRows( rowCount( params ) );
+      const quint64     startBit( params.offsetBits );
+
+      overview.reset( params.width, totalRows );
+      if ( totalRows == 0 )
+         return true;
+
+      const int   chunkRows( int( qBound( quint64( 1 ), OverviewChunkPixels / params.width,
+                                          qMin( totalRows, quint64( INT_MAX ) ) ) ) );
+      QImage      chunk( params.width, chunkRows, QImage::Format_RGB32 );
+
+      for ( quint64 row = 0; row < totalRows; row += chunkRows )
+      {
+         const int   rows( int( qMin( quint64( chunkRows ), totalRows - row ) ) );
+         BandDecoder band( m_data, m_dataBitCount, startBit + row * rowBits, rowBits,
+                           decodeRow, layout, chunk.bits(), chunk.bytesPerLine(),
+                           params.width, rows, cancel );
+
+         band.run();
+         if ( cancel && cancel->fetchAndAddRelaxed( 0 ) )
+            return false;
+
+         overview.accumulate( chunk, rows );
+      }
+
+      return true;
    }
 
 
 
+   bool Imager::buildEntropyMap( EntropyMap& map, QAtomicInt* cancel )
+   {
+      ScopedTimer timer( "build entropy map" );
+      const quint64  byteCount( m_dataBitCount / 8 );
+
+      map.reset( byteCount );
+
+      // The chunks are independent, so they are counted across the thread
+      // pool, but a batch (one task per thread) at a time: renders started
+      // meanwhile queue behind one batch rather than the whole file.
+      const quint64  chunkCount( map.chunkCount() );
+      const quint64  taskChunks( EntropyTaskBytes / EntropyMap::ChunkBytes );
+      const quint64  batchChunks( taskChunks * quint64( qMax( m_threadPool.maxThreadCount(), 1 ) ) );
+
+      for ( quint64 first = 0; first < chunkCount; first += batchChunks )
+      {
+         const quint64                    end( qMin( chunkCount, first + batchChunks ) );
+         std::vector< EntropyCounter* >   tasks;
+
+         for ( quint64 c = first; c < end; c += taskChunks )
+            tasks.push_back( new EntropyCounter( m_data, byteCount, c, qMin( taskChunks, end - c ),
+                                                 map, cancel ) );
+
+         runBands( tasks, m_threadPool );
+         if ( cancel && cancel->fetchAndAddRelaxed( 0 ) )
+            return false;
+      }
+
+      return true;
+   }
 
-   uint Imager::pixelBRG( unsigned int& di, BitArraySizeType& bai, unsigned int& limit )
+
+
+   std::vector< Imager::SourceBit > Imager::pixelBits( const RenderParams& params, quint64 row,
+                                                       unsigned int column ) const
    {
-      unsigned char b( mapBits( m_blueBitCount, di, bai, limit ) );
-      unsigned char r( mapBits( m_redBitCount, di, bai, limit ) );
-      unsigned char g( mapBits( m_greenBitCount, di, bai, limit ) );
+      const quint64              totalRows( rowCount( params ) );
+      std::vector< SourceBit >   bits;
 
-      return qRgb( r, g, b );
+      if ( row < totalRows && column < params.width )
+         PixelLayout( params, totalRows ).sourceBits( row, column, bits );
+      return bits;
    }
 
 
 
+   void Imager::recycle( QImage* image )
+   {
+      if ( image )
+      {
+         m_imagePool->release( *image );
+         delete image;
+      }
+   }
+
+
 
-   uint Imager::pixelGray( unsigned int& di, BitArraySizeType& bai, unsigned int& limit )
+   QByteArray Imager::bytes( quint64 firstByte, int count ) const
    {
-      unsigned char gr( mapBits( m_grayBitCount, di, bai, limit ) );
-      return qRgb( gr, gr, gr );
+      const quint64  byteCount( m_dataBitCount / 8 );
+
+      if ( ! m_data || count <= 0 || firstByte >= byteCount )
+         return QByteArray();
+
+      return QByteArray( reinterpret_cast< const char* >( m_data + firstByte ),
+                         int( qMin( quint64( count ), byteCount - firstByte ) ) );
    }
 
 
 
+   void Imager::unload()
+   {
+      if ( m_data )
+         Profiler::instance().adjustCounter( "source bytes", -qint64( m_dataBitCount / 8 ) );
+      if ( m_data && m_buffer.isEmpty() )
+         m_file.unmap( const_cast< uchar* >( m_data ) );
+      m_file.close();
+      m_buffer.clear();
+      m_data = NULL;
+      m_dataBitCount = 0;
+      m_tileCache->clear();
+   }
+
+
 }  // namespace LP
 
 
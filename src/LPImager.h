@@ -20,12 +20,16 @@
 #define LPIMAGER_H
 
 
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
 #include <QString>
+#include <QThreadPool>
 
 #include <vector>
 
 /// Forward decls
-class QBitArray;
 class QImage;
 
 
@@ -33,10 +37,15 @@ class QImage;
 namespace LP
 {
 
+class EntropyMap;
+class ImagePool;
+class Overview;
+class TileCache;
 
-class Imager //: public QObject
+
+class Imager : public QObject
 {
-//   Q_OBJECT
+   Q_OBJECT
 
 public:
    /// Standard constructor
@@ -50,44 +59,213 @@ public:
       RGB, RBG, BGR, BRG, GRB, GBR, Grayscale 
    } ChannelOrder;
 
-   bool load( const QString& filename, unsigned int blockSize );
+   /// Order of the bytes of a pixel (or planar sample) that is a whole
+   /// number of bytes long.
+   typedef enum
+   {
+      BigEndian, LittleEndian
+   } ByteOrder;
+
+   /// Where in each byte the bit stream starts.
+   typedef enum
+   {
+      MsbFirst, LsbFirst
+   } BitOrder;
+
+   /// Everything that determines how the data is turned into images.
+   struct RenderParams
+   {
+      RenderParams();
+
+      bool operator==( const RenderParams& other ) const;
+      bool operator!=( const RenderParams& other ) const { return ! ( *this == other ); }
+
+      /// Describes the channel layout, e.g. "5/6/5 BGR", "16-bit gray LE"
+      /// or "8/8/8/8 RGBA".
+      QString layoutName() const;
+
+      /// Bits from the start of one row to the start of the next.
+      quint64 rowBits() const;
+
+      /**@brief Whether these parameters show the same rows as @a other,
+         moved: everything but the offset agrees and the offsets are a
+         whole number of rows apart.  If so, @a rowShift is set to how many
+         rows later row 0 of these parameters starts than row 0 of
+         @a other's (negative if earlier).
+      */
+      bool isRowShiftOf( const RenderParams& other, qint64& rowShift ) const;
+
+      /// Bits of each channel, 0..16; wider channels keep their top 8 bits.
+      unsigned int   redBitCount, greenBitCount, blueBitCount, grayBitCount;
+      ChannelOrder   order;
+      /// Bits of an alpha (or padding) channel, 0..16; skipped when drawn.
+      unsigned int   alphaBitCount;
+      /// Whether the alpha channel comes before the others rather than after.
+      bool           alphaFirst;
+      ByteOrder      byteOrder;
+      BitOrder       bitOrder;
+      /// Whether each channel is stored as a plane of its own, one after
+      /// the other, rather than interleaved pixel by pixel.
+      bool           planar;
+      unsigned int   width;
+      /// Bits skipped at the start of the data; need not be whole bytes.
+      quint64        offsetBits;
+   };
+
+   /// Where one bit that a pixel is decoded from lies in the data.
+   struct SourceBit
+   {
+      quint64        byte;
+      /// Place of the bit within its byte, 0 being the least significant.
+      unsigned int   bit;
+      /// The channel it belongs to: 'R', 'G', 'B', 'Y' (gray) or 'A' (alpha).
+      char           channel;
+   };
+
+   /**@brief Opens @a filename as the source data.
+
+      Safe to call from a worker thread; progress() is emitted as the file
+      is opened.  Returns false if the file can't be read or the load was
+      cancelled with cancelLoad().
+   */
+   bool load( const QString& filename );
+
+   /// Makes a load() in progress (on another thread) give up as soon as possible.
+   void cancelLoad();
+
+   /**@brief Returns the number of complete rows the data makes with
+      @a params.
 
-   void regenerate( unsigned int redBitCount,
-                    unsigned int greenBitCount,
-                    unsigned int blueBitCount,
-                    unsigned int grayBitCount,
-                    ChannelOrder order,
-                    unsigned int width,
-                    unsigned int offset,
-                    std::vector< QImage* >& imgVec
-                  );
+      The data is one continuous stream of bits from the offset on, so
+      together the rows form a single image of any height; the functions
+      below decode whichever rows of it are asked for.
+   */
+   quint64 rowCount( const RenderParams& params ) const;
 
+   /**@brief Decodes @a rowCount rows starting at row @a firstRow into the
+      top of @a dst, which must be a Format_RGB32 image at least that tall
+      and params.width wide.
 
-//signals:
-   //void progress( int cur, int goal );
+      Nothing is cached, so this suits passes over the whole data.
+      Returns false if the rows run past the data or the render was
+      cancelled through @a cancel.
+   */
+   bool decodeRows( const RenderParams& params, quint64 firstRow, QImage& dst,
+                    int rowCount, QAtomicInt* cancel = NULL );
+
+   /**@brief Decodes every row with @a params, a few MB of pixels at a
+      time, and throws the pixels away: for timing a layout or checking
+      that it decodes.  Returns false if a chunk could not be decoded or
+      the pass was cancelled through @a cancel.
+   */
+   bool decodeAll( const RenderParams& params, QAtomicInt* cancel = NULL );
+
+   /**@brief Decodes rows @a firstRow .. @a firstRow + @a rowCount - 1 of
+      the data as described by @a params into a single image, which the
+      caller then owns.
+
+      The rows are assembled from tiles, and only tiles that aren't in the
+      tile cache get decoded (and then cached).  Tiles are cached by their
+      place in the data rather than their row number, so after the offset
+      moves by whole rows only the rows new to the view get decoded.
+      Rows past the end of the data are left off.  Returns NULL if there
+      are no such rows or the render was cancelled through @a cancel.
+      Hand the image to recycle() once done with it.
+   */
+   QImage* renderRows( const RenderParams& params, quint64 firstRow,
+                       unsigned int rowCount, QAtomicInt* cancel = NULL );
+
+   /**@brief Renders the same rows under each of @a paramSets, appending
+      one image per set (NULL where a set has no such rows) to @a images.
+
+      Like the single-set renderRows, but the missing tiles of every set
+      are decoded in one go across the thread pool, so that many small
+      renders keep every core busy, and identical sets are decoded only
+      once.  Returns false, appending nothing, if cancelled through
+      @a cancel.
+   */
+   bool renderRows( const std::vector< RenderParams >& paramSets, quint64 firstRow,
+                    unsigned int rowCount, std::vector< QImage* >& images,
+                    QAtomicInt* cancel = NULL );
+
+   /**@brief Decodes all of the data as described by @a params, once, into
+      @a overview.
+
+      Meant to run in the background: rows are decoded a chunk at a time
+      on the calling thread alone, leaving the thread pool to interactive
+      renders, and @a overview can be looked at while it fills in.
+      Returns false if cancelled through @a cancel.
+   */
+   bool buildOverview( const RenderParams& params, Overview& overview,
+                       QAtomicInt* cancel = NULL );
+
+   /**@brief Fills @a entropyMap with the entropy of every chunk of the
+      data and the histogram of all of its bytes.
+
+      The chunks are counted across the thread pool, a batch at a time so
+      that interactive renders aren't held up for long, and @a entropyMap
+      can be looked at while it fills in.  Returns false if cancelled
+      through @a cancel.
+   */
+   bool buildEntropyMap( EntropyMap& entropyMap, QAtomicInt* cancel = NULL );
+
+   /**@brief Deletes @a image, an image renderRows made, keeping its pixel
+      memory for the renders to come.  Safe from any thread.
+   */
+   void recycle( QImage* image );
+
+   /**@brief Returns where each bit of the pixel at @a row, @a column
+      comes from, channel by channel in the order they are stored and each
+      channel's most significant bit first.  Empty if there is no such
+      pixel.
+   */
+   std::vector< SourceBit > pixelBits( const RenderParams& params, quint64 row,
+                                       unsigned int column ) const;
+
+   /// Size of the loaded data, in bits.
+   quint64 dataBitCount() const { return m_dataBitCount; }
+
+   /// Returns a copy of up to @a count bytes of the data starting at byte
+   /// @a firstByte (fewer near the end).  Safe from any thread.
+   QByteArray bytes( quint64 firstByte, int count ) const;
+
+   /// Sets how much memory (in bytes) the tile cache may use.
+   void setCacheBudget( qint64 budget );
+   /// The tile cache, for its statistics.
+   const TileCache& tileCache() const { return *m_tileCache; }
+
+   /// Sets how many threads rows are decoded with; 0 means one per core.
+   void setThreadCount( int threadCount );
+   int threadCount() const;
+
+
+signals:
+   void progress( int cur, int goal );
 
 private:
    void unload();
+   /// Reads the whole (unmappable) file into m_buffer; returns NULL on failure.
+   const uchar* readAll( qint64 fileSize );
 
-   typedef std::vector< QBitArray* >::size_type BitArraySizeType;
-
-   unsigned char mapBits( int bitCount, unsigned int& di, BitArraySizeType& bai, unsigned int& limit );
-   uint pixelRGB( unsigned int& di, BitArraySizeType& bai, unsigned int& limit );
-   uint pixelRBG( unsigned int& di, BitArraySizeType& bai, unsigned int& limit );
-   uint pixelGBR( unsigned int& di, BitArraySizeType& bai, unsigned int& limit );
-   uint pixelGRB( unsigned int& di, BitArraySizeType& bai, unsigned int& limit );
-   uint pixelBGR( unsigned int& di, BitArraySizeType& bai, unsigned int& limit );
-   uint pixelBRG( unsigned int& di, BitArraySizeType& bai, unsigned int& limit );
-   uint pixelGray( unsigned int& di, BitArraySizeType& bai, unsigned int& limit );
+   /// The source file; kept open for as long as it is mapped.
+   QFile          m_file;
+   /// Holds the file contents only if the file could not be mapped.
+   QByteArray     m_buffer;
+   /// Start of the source bytes (mapped or buffered); NULL if nothing loaded.
+   const uchar*   m_data;
+   /// Size of the source data, in bits.
+   quint64        m_dataBitCount;
 
-   typedef uint (LP::Imager::*PixelFn)(unsigned int&, BitArraySizeType&, unsigned int&);
-   PixelFn   m_pixelFunc;
+   /// Set by cancelLoad(); polled by load().
+   QAtomicInt     m_loadCancelled;
 
-   std::vector< QBitArray* >  m_bitArrayVec;
+   /// Decodes row bands in parallel for decodeRows and renderRows.
+   QThreadPool    m_threadPool;
 
-   unsigned int  m_redBitCount, m_greenBitCount, m_blueBitCount, m_grayBitCount;
-   unsigned int  m_bitsPerPixel;
-   unsigned int  m_blockSize;
+   /// Pixel memory of images that are no longer needed, for renderRows.
+   ImagePool*     m_imagePool;
+   /// Recently decoded tiles, for renderRows.
+   TileCache*     m_tileCache;
 }; 
 
 }  // namespace LP
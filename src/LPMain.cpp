@@ -14,16 +14,35 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include "LPBatch.h"
 #include "LPMainWindow.h"
+#include "LPProfiler.h"
 
 #include "ui_MainWindow.h"
 
+#include <QCoreApplication>
 #include <QMessageBox>
 
 
 
 int main(int argc, char *argv[])
 {
+	// Made up front, so that worker threads never race to create it.
+	LP::Profiler& profiler( LP::Profiler::instance() );
+	// Setting LP_TRACE to a file name records a Chrome trace of the run.
+	const QByteArray trace( qgetenv( "LP_TRACE" ) );
+
+	if ( ! trace.isEmpty() )
+		profiler.startTrace( QString::fromLocal8Bit( trace ) );
+
+	// Batch mode renders without a display, so it needs no QApplication.
+	if ( LP::Batch::isRequested( argc, argv ) )
+	{
+		QCoreApplication app(argc, argv);
+
+		return LP::Batch::run( app.arguments() );
+	}
+
 	QApplication app(argc, argv);
 	LPUI::MainWindow mainWindow;
 
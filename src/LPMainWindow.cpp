@@ -21,10 +21,12 @@
 
 #include <QUiLoader>
 #include <QMessageBox>
-#include <QLabel>
 #include <QCloseEvent>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QProgressDialog>
+#include <QDockWidget>
+#include <QScrollBar>
 #include <QTextStream>
 #include <QThread>
 #include <QShortcut>
@@ -33,7 +35,16 @@
 #include <QSettings>
 
 #include "LPMainWindow.h"
+#include "LPEntropyStrip.h"
+#include "LPExporter.h"
+#include "LPHexInspector.h"
+#include "LPHypothesisGrid.h"
 #include "LPImager.h"
+#include "LPOverviewWidget.h"
+#include "LPPreviewWidget.h"
+#include "LPProfiler.h"
+#include "LPStridePanel.h"
+#include "LPTileCache.h"
 
 #include <assert.h>
 #include <math.h>
@@ -42,7 +53,7 @@
 
 namespace LPUI
 {
-#if 0
+   /// Loads a file into a fresh Imager off the GUI thread.
    class DataLoader : public QThread
    {
    public:
@@ -50,31 +61,70 @@ namespace LPUI
          : QThread() 
          , m_filename( filename )
          , m_imager( imgr )
+         , m_success( false )
       { }
 
       virtual void run()
       {
-         m_imager->load( m_filename );
+         m_success = m_imager->load( m_filename );
       }
 
+      LP::Imager* imager() const { return m_imager; }
+      const QString& filename() const { return m_filename; }
+      bool succeeded() const { return m_success; }
+
    private:
-      QString     m_filename;
-      LP::Imager* m_imager;
+      QString        m_filename;
+      LP::Imager*    m_imager;
+      bool           m_success;
    };
-#endif
 
 
 MainWindow::MainWindow(QWidget *parent)
 : QMainWindow( parent )
 , m_imager(NULL)
+, m_loader(NULL)
+, m_loadProgress(NULL)
+, m_exportProgress(NULL)
 , m_channelOrder( LP::Imager::RGB )
 {
    m_ui.setupUi(this);
 
-   m_imagePreviewFrame = new QFrame();
-   m_imagePreviewFrame->setLayout( new QVBoxLayout( m_imagePreviewFrame ) );
+   m_preview = new PreviewWidget();
+   m_ui.m_previewScrollArea->setWidget( m_preview );
+
+   m_entropyStrip = new EntropyStrip();
+   m_ui.gridLayout_3->addWidget( m_entropyStrip, 4, 2, 6, 1 );
+
+   QDockWidget*   overviewDock( new QDockWidget( tr("Overview"), this ) );
+
+   m_overview = new OverviewWidget( overviewDock );
+   overviewDock->setObjectName( "overviewDock" );
+   overviewDock->setWidget( m_overview );
+   addDockWidget( Qt::RightDockWidgetArea, overviewDock );
+
+   QDockWidget*   strideDock( new QDockWidget( tr("Strides"), this ) );
+
+   m_stridePanel = new StridePanel( strideDock );
+   m_stridePanel->setMaxWidth( m_ui.m_widthSlider->maximum() );
+   strideDock->setObjectName( "strideDock" );
+   strideDock->setWidget( m_stridePanel );
+   addDockWidget( Qt::RightDockWidgetArea, strideDock );
+
+   QDockWidget*   hypothesisDock( new QDockWidget( tr("Hypotheses"), this ) );
 
-   m_ui.m_previewScrollArea->setWidget(m_imagePreviewFrame);
+   m_hypotheses = new HypothesisGrid( hypothesisDock );
+   m_hypotheses->setMaxWidth( m_ui.m_widthSlider->maximum() );
+   hypothesisDock->setObjectName( "hypothesisDock" );
+   hypothesisDock->setWidget( m_hypotheses );
+   addDockWidget( Qt::BottomDockWidgetArea, hypothesisDock );
+
+   QDockWidget*   hexDock( new QDockWidget( tr("Bytes"), this ) );
+
+   m_hexInspector = new HexInspector( hexDock );
+   hexDock->setObjectName( "hexDock" );
+   hexDock->setWidget( m_hexInspector );
+   addDockWidget( Qt::RightDockWidgetArea, hexDock );
 
    m_redBitCount = 3;
    m_greenBitCount = 2;
@@ -92,6 +142,10 @@ MainWindow::MainWindow(QWidget *parent)
       SIGNAL(triggered()),
       SLOT(onExportActionTriggered()));
 
+   connect(m_ui.actionExportSingle,
+      SIGNAL(triggered()),
+      SLOT(onExportSingleActionTriggered()));
+
    connect(m_ui.actionExit,
       SIGNAL(triggered()),
       SLOT(onExitActionTriggered()));
@@ -112,6 +166,26 @@ MainWindow::MainWindow(QWidget *parent)
       SIGNAL( valueChanged(int) ),
       SLOT(onGrayChannelMaskChanged()));
 
+   connect(m_ui.m_alphaBitsSpinBox,
+      SIGNAL( valueChanged(int) ),
+      SLOT(recomputePreview()));
+
+   connect(m_ui.m_alphaFirstCheckBox,
+      SIGNAL( toggled(bool) ),
+      SLOT(recomputePreview()));
+
+   connect(m_ui.m_littleEndianCheckBox,
+      SIGNAL( toggled(bool) ),
+      SLOT(recomputePreview()));
+
+   connect(m_ui.m_lsbFirstCheckBox,
+      SIGNAL( toggled(bool) ),
+      SLOT(recomputePreview()));
+
+   connect(m_ui.m_planarCheckBox,
+      SIGNAL( toggled(bool) ),
+      SLOT(recomputePreview()));
+
    connect(m_ui.m_blockSizeLineEdit,
       SIGNAL( textEdited(const QString&) ),
       SLOT(onBlockSizeLineEditChanged()));
@@ -136,6 +210,47 @@ MainWindow::MainWindow(QWidget *parent)
       SIGNAL( valueChanged(int) ),
       SLOT(onOffsetSliderChanged(int)));
 
+   connect(m_ui.m_offsetBitsSpinBox,
+      SIGNAL( valueChanged(int) ),
+      SLOT(onOffsetBitsChanged(int)));
+
+   connect(m_ui.m_threadCountSpinBox,
+      SIGNAL( valueChanged(int) ),
+      SLOT(onThreadCountChanged(int)));
+
+   connect(m_ui.m_cacheSizeSpinBox,
+      SIGNAL( valueChanged(int) ),
+      SLOT(onCacheSizeChanged(int)));
+
+   connect(m_preview,
+      SIGNAL( rowsRendered() ),
+      SLOT(updateStatus()));
+
+   connect(m_overview,
+      SIGNAL( rowActivated(quint64) ),
+      SLOT(onOverviewRowActivated(quint64)));
+
+   connect(m_preview,
+      SIGNAL( pixelHovered(quint64, unsigned int) ),
+      m_hexInspector,
+      SLOT(showPixel(quint64, unsigned int)));
+
+   connect(m_stridePanel,
+      SIGNAL( candidateChosen(const LP::Imager::RenderParams&) ),
+      SLOT(onLayoutChosen(const LP::Imager::RenderParams&)));
+
+   connect(m_hypotheses,
+      SIGNAL( hypothesisChosen(const LP::Imager::RenderParams&) ),
+      SLOT(onLayoutChosen(const LP::Imager::RenderParams&)));
+
+   connect(m_ui.m_previewScrollArea->verticalScrollBar(),
+      SIGNAL( valueChanged(int) ),
+      SLOT(onPreviewScrolled()));
+
+   connect(m_ui.m_previewScrollArea->verticalScrollBar(),
+      SIGNAL( rangeChanged(int, int) ),
+      SLOT(onPreviewScrolled()));
+
    connect(m_ui.m_rgbChOrderRadioButton,
       SIGNAL( clicked() ),
       SLOT(onChannelOrderChanged()) );
@@ -168,6 +283,14 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+   abandonLoad();
+   m_preview->setSource( NULL, LP::Imager::RenderParams() );
+   m_overview->setSource( NULL, LP::Imager::RenderParams() );
+   m_stridePanel->setSource( NULL, LP::Imager::RenderParams() );
+   m_hypotheses->setSource( NULL, LP::Imager::RenderParams() );
+   m_hexInspector->setSource( NULL, LP::Imager::RenderParams() );
+   m_entropyStrip->setSource( NULL, LP::Imager::RenderParams() );
+   delete m_imager;
 }
 
 
@@ -191,45 +314,166 @@ void MainWindow::onOpenActionTriggered()
 
    if ( ! filename.isEmpty() )
    {
+      // The current file stays on screen until the new one has loaded.
+      abandonLoad();
+
       LP::Imager*  newImg( new LP::Imager() );
-      // DataLoader   loader( newImg, filename );
-      if ( newImg->load( filename, m_ui.m_blockSizeSlider->value() * 1024 * 1024 ) )
-      {
-         QFileInfo   fi( filename );
-
-         delete m_imager;
-         m_imager = newImg;
-         m_sourceFilename = filename;
-         m_ui.m_sourceFilenameLabel->setText( filename );
-         m_ui.m_sourceSizeLabel->setText( QString::number( fi.size() ) + tr(" bytes") );
-         regenerate();
-      }
+      newImg->setThreadCount( m_ui.m_threadCountSpinBox->value() );
+      newImg->setCacheBudget( qint64( m_ui.m_cacheSizeSpinBox->value() ) * 1024 * 1024 );
+
+      m_loader = new DataLoader( newImg, filename );
+
+      m_loadProgress = new QProgressDialog( tr("Loading %1").arg( filename ),
+                                            tr("Cancel"), 0, 1, this );
+      m_loadProgress->setWindowTitle( tr("Loading") );
+
+      connect(newImg,
+         SIGNAL( progress(int, int) ),
+         SLOT(onLoadProgress(int, int)));
+
+      connect(m_loadProgress,
+         SIGNAL( canceled() ),
+         SLOT(onLoadCanceled()));
+
+      connect(m_loader,
+         SIGNAL( finished() ),
+         SLOT(onLoadFinished()));
+
+      m_loader->start();
+   }
+}
+
+
+void MainWindow::onLoadProgress( int cur, int goal )
+{
+   if ( m_loadProgress )
+   {
+      m_loadProgress->setMaximum( goal );
+      m_loadProgress->setValue( cur );
    }
 }
 
 
+void MainWindow::onLoadCanceled()
+{
+   if ( m_loader )
+      m_loader->imager()->cancelLoad();
+}
+
+
+void MainWindow::onLoadFinished()
+{
+   // Ignore notifications from loads that were abandoned.
+   if ( ! m_loader || m_loader->isRunning() )
+      return;
+
+   DataLoader*    loader( m_loader );
+   LP::Imager*    newImg( loader->imager() );
+   bool           cancelled( m_loadProgress && m_loadProgress->wasCanceled() );
+
+   m_loader = NULL;
+   delete m_loadProgress;
+   m_loadProgress = NULL;
+
+   if ( loader->succeeded() )
+   {
+      QFileInfo   fi( loader->filename() );
+
+      // Stop rendering the old data before it goes away.
+      m_preview->setSource( newImg, currentParams() );
+      m_overview->setSource( newImg, currentParams() );
+      m_stridePanel->setSource( newImg, currentParams() );
+      m_hypotheses->setSource( newImg, currentParams() );
+      m_hexInspector->setSource( newImg, currentParams() );
+      m_entropyStrip->setSource( newImg, currentParams() );
+      delete m_imager;
+      m_imager = newImg;
+      m_sourceFilename = loader->filename();
+      m_ui.m_sourceFilenameLabel->setText( m_sourceFilename );
+      m_ui.m_sourceSizeLabel->setText( QString::number( fi.size() ) + tr(" bytes") );
+      syncOffsetSlider();
+      recomputePreview();
+   }
+   else
+   {
+      if ( ! cancelled )
+         QMessageBox::warning( this, tr("Open Failed"),
+               tr("Could not read %1.").arg( loader->filename() ) );
+      delete newImg;
+   }
+
+   delete loader;
+}
+
+
+void MainWindow::abandonLoad()
+{
+   if ( m_loader )
+   {
+      m_loader->imager()->cancelLoad();
+      m_loader->wait();
+      delete m_loader->imager();
+      delete m_loader;
+      m_loader = NULL;
+   }
+
+   delete m_loadProgress;
+   m_loadProgress = NULL;
+}
+
+
 void MainWindow::onExportActionTriggered()
+{
+   QString   filename( askExportFilename() );
+
+   if ( ! filename.isEmpty() )
+   {
+      exportImages( filename );
+   }
+}
+
+
+void MainWindow::onExportSingleActionTriggered()
+{
+   QString   filename( askExportFilename() );
+
+   if ( filename.isEmpty() )
+      return;
+
+   // In the order of LP::TiffWriter::Compression.
+   QStringList compressions;
+   bool        ok( false );
+
+   compressions << tr("None") << tr("Deflate") << tr("LZW");
+
+   QString   choice( QInputDialog::getItem( this, tr("Export Single Image"),
+                           tr("Compression:"), compressions, 1, false, &ok ) );
+
+   if ( ok )
+   {
+      exportImages( filename, true,
+                    LP::TiffWriter::Compression( compressions.indexOf( choice ) ) );
+   }
+}
+
+
+QString MainWindow::askExportFilename()
 {
    if ( m_sourceFilename.isEmpty() )
    {
       QMessageBox::warning( this, tr("No source file"),
             tr("No data file has been loaded yet!") );
-      return;
+      return QString();
    }
 
    QString   filename;
    QFileInfo fi( m_sourceFilename );
 
    filename = fi.absolutePath() + "/" + fi.completeBaseName() + ".tiff";
-   filename = QFileDialog::getSaveFileName( this, 
+   return QFileDialog::getSaveFileName( this, 
                            tr("Specify base output filename"), 
                            filename,
                            tr("TIFF Files (*.tiff)") );
-
-   if ( ! filename.isEmpty() )
-   {
-      regenerate( filename );
-   }
 }
 
 
@@ -346,7 +590,7 @@ void MainWindow::onWidthSliderChanged(int val)
 
 void MainWindow::onOffsetLineEditChanged()
 {
-   m_ui.m_offsetSlider->setValue( m_ui.m_offsetLineEdit->text().toInt() );
+   syncOffsetSlider();
    recomputePreview();
 }
 
@@ -354,16 +598,94 @@ void MainWindow::onOffsetLineEditChanged()
 
 void MainWindow::onOffsetSliderChanged(int val)
 {
-   m_ui.m_offsetLineEdit->setText( QString::number( val ) );
+   // The slider spans the whole file, however large; the line edit holds
+   // the exact byte.
+   const qint64   fileSize( m_imager ? qint64( m_imager->dataBitCount() / 8 ) : 0 );
+   const qint64   bytes( qint64( double( val ) / m_ui.m_offsetSlider->maximum() * fileSize ) );
+
+   m_ui.m_offsetLineEdit->setText( QString::number( bytes ) );
    recomputePreview();
 }
 
 
 
+void MainWindow::syncOffsetSlider()
+{
+   const qint64   fileSize( m_imager ? qint64( m_imager->dataBitCount() / 8 ) : 0 );
+   const qint64   bytes( m_ui.m_offsetLineEdit->text().toLongLong() );
+   const int      val( fileSize > 0 ? int( qBound( 0.0, double( bytes ) / fileSize, 1.0 ) *
+                                           m_ui.m_offsetSlider->maximum() ) : 0 );
+
+   // Moving the slider here must not round the offset to a slider step.
+   m_ui.m_offsetSlider->blockSignals( true );
+   m_ui.m_offsetSlider->setValue( val );
+   m_ui.m_offsetSlider->blockSignals( false );
+}
+
+
+
+void MainWindow::onOffsetBitsChanged(int val)
+{
+   if ( val >= 0 && val <= 7 )
+   {
+      recomputePreview();
+      return;
+   }
+
+   const qint64   bytes( m_ui.m_offsetLineEdit->text().toLongLong() );
+
+   m_ui.m_offsetBitsSpinBox->blockSignals( true );
+   if ( val < 0 && bytes <= 0 )
+   {
+      // Nothing comes before the start of the file.
+      m_ui.m_offsetBitsSpinBox->setValue( 0 );
+      m_ui.m_offsetBitsSpinBox->blockSignals( false );
+      return;
+   }
+   m_ui.m_offsetBitsSpinBox->setValue( val > 7 ? 0 : 7 );
+   m_ui.m_offsetBitsSpinBox->blockSignals( false );
+
+   m_ui.m_offsetLineEdit->setText( QString::number( val > 7 ? bytes + 1 : bytes - 1 ) );
+   onOffsetLineEditChanged();
+}
+
+
+
+
+
+void MainWindow::onThreadCountChanged(int val)
+{
+   if ( m_imager )
+   {
+      m_imager->setThreadCount( val );
+      recomputePreview();
+   }
+}
+
+
+
+void MainWindow::onCacheSizeChanged(int val)
+{
+   if ( m_imager )
+   {
+      m_imager->setCacheBudget( qint64( val ) * 1024 * 1024 );
+      updateStatus();
+   }
+}
+
+
+
 
 
 void MainWindow::closeEvent( QCloseEvent* event )
 {
+   abandonLoad();
+   m_preview->setSource( NULL, LP::Imager::RenderParams() );
+   m_overview->setSource( NULL, LP::Imager::RenderParams() );
+   m_stridePanel->setSource( NULL, LP::Imager::RenderParams() );
+   m_hypotheses->setSource( NULL, LP::Imager::RenderParams() );
+   m_hexInspector->setSource( NULL, LP::Imager::RenderParams() );
+   m_entropyStrip->setSource( NULL, LP::Imager::RenderParams() );
    event->accept();
 }
 
@@ -372,83 +694,198 @@ void MainWindow::closeEvent( QCloseEvent* event )
 
 void MainWindow::recomputePreview()
 {
-   regenerate();
+   if ( m_imager )
+   {
+      const LP::Imager::RenderParams   params( currentParams() );
+
+      m_preview->setSource( m_imager, params );
+      m_overview->setSource( m_imager, params );
+      m_stridePanel->setSource( m_imager, params );
+      m_hypotheses->setSource( m_imager, params );
+      m_hexInspector->setSource( m_imager, params );
+      m_entropyStrip->setSource( m_imager, params );
+      updateStatus();
+      onPreviewScrolled();
+   }
+}
+
+
+
+void MainWindow::onPreviewScrolled()
+{
+   QWidget* const viewport( m_ui.m_previewScrollArea->viewport() );
+   const int      firstRow( m_ui.m_previewScrollArea->verticalScrollBar()->value() );
+
+   m_overview->setViewRows( firstRow, viewport->height() );
+   m_entropyStrip->setView( firstRow,
+                            m_entropyStrip->mapFromGlobal( viewport->mapToGlobal( QPoint( 0, 0 ) ) ).y() );
+}
+
+
+
+void MainWindow::onOverviewRowActivated( quint64 row )
+{
+   const int   half( m_ui.m_previewScrollArea->viewport()->height() / 2 );
+
+   // Put the row in the middle of the preview (as far as Qt can scroll).
+   m_ui.m_previewScrollArea->verticalScrollBar()->setValue(
+         int( qMin( row, quint64( QWIDGETSIZE_MAX ) ) ) - half );
+}
+
+
+
+void MainWindow::onLayoutChosen( const LP::Imager::RenderParams& params )
+{
+   // Set every control quietly, then render once.
+   m_ui.m_widthLineEdit->setText( QString::number( params.width ) );
+   m_ui.m_widthSlider->blockSignals( true );
+   m_ui.m_widthSlider->setValue( params.width );
+   m_ui.m_widthSlider->blockSignals( false );
+
+   QSpinBox* const   spinBoxes[] = { m_ui.m_redBitsSpinBox, m_ui.m_greenBitsSpinBox,
+                                     m_ui.m_blueBitsSpinBox, m_ui.m_grayBitsSpinBox,
+                                     m_ui.m_alphaBitsSpinBox };
+   const int         bitCounts[] = { int( params.redBitCount ), int( params.greenBitCount ),
+                                     int( params.blueBitCount ), int( params.grayBitCount ),
+                                     int( params.alphaBitCount ) };
+
+   for ( int i = 0; i < 5; ++i )
+   {
+      spinBoxes[i]->blockSignals( true );
+      spinBoxes[i]->setValue( bitCounts[i] );
+      spinBoxes[i]->blockSignals( false );
+   }
+
+   QCheckBox* const  checkBoxes[] = { m_ui.m_alphaFirstCheckBox, m_ui.m_littleEndianCheckBox,
+                                      m_ui.m_lsbFirstCheckBox, m_ui.m_planarCheckBox };
+   const bool        checks[] = { params.alphaFirst, params.byteOrder == LP::Imager::LittleEndian,
+                                  params.bitOrder == LP::Imager::LsbFirst, params.planar };
+
+   for ( int i = 0; i < 4; ++i )
+   {
+      checkBoxes[i]->blockSignals( true );
+      checkBoxes[i]->setChecked( checks[i] );
+      checkBoxes[i]->blockSignals( false );
+   }
+
+   QRadioButton* const  orderButtons[] = { m_ui.m_rgbChOrderRadioButton, m_ui.m_rbgChOrderRadioButton,
+                                           m_ui.m_bgrChOrderRadioButton, m_ui.m_brgChOrderRadioButton,
+                                           m_ui.m_grbChOrderRadioButton, m_ui.m_gbrChOrderRadioButton,
+                                           m_ui.m_grayChOrderRadioButton };
+
+   orderButtons[ params.order ]->setChecked( true );
+   m_channelOrder = params.order;
+
+   recomputePreview();
+}
+
+
+
+void MainWindow::updateStatus()
+{
+   if ( m_imager )
+   {
+      const LP::TileCache::Stats   cache( m_imager->tileCache().stats() );
+      const LP::Profiler&          profiler( LP::Profiler::instance() );
+      const qint64                 imageBytes( profiler.counter( "tile cache bytes" ) +
+                                               profiler.counter( "preview image bytes" ) +
+                                               profiler.counter( "overview bytes" ) +
+                                               profiler.counter( "image pool bytes" ) );
+
+      // The most recent run of each stage the preview goes through.
+      statusBar()->showMessage( tr("%1 x %2 pixels    Cache: %3 tiles, %4 MB, %5 hits, %6 misses"
+                                   "    Load %7 ms, render %8 ms, paint %9 ms")
+                                 .arg( currentParams().width )
+                                 .arg( m_preview->rowCount() )
+                                 .arg( cache.tileCount )
+                                 .arg( cache.bytes / ( 1024 * 1024 ) )
+                                 .arg( cache.hits )
+                                 .arg( cache.misses )
+                                 .arg( profiler.stage( "load" ).lastNs / 1e6, 0, 'f', 1 )
+                                 .arg( profiler.stage( "render rows" ).lastNs / 1e6, 0, 'f', 1 )
+                                 .arg( profiler.stage( "paint preview" ).lastNs / 1e6, 0, 'f', 1 )
+                                 + tr("    Memory: source %1 MB, images %2 MB")
+                                 .arg( profiler.counter( "source bytes" ) / ( 1024 * 1024 ) )
+                                 .arg( imageBytes / ( 1024 * 1024 ) ) );
+   }
 }
 
 
 
-void MainWindow::regenerate( const QString& filename )
+LP::Imager::RenderParams MainWindow::currentParams()
 {
-   unsigned int width( m_ui.m_widthLineEdit->text().toInt() );
-   if ( width < 1 )
-      width = 1;
-   unsigned int offset( m_ui.m_offsetLineEdit->text().toInt() );
+   LP::Imager::RenderParams   params;
+
+   params.width = m_ui.m_widthLineEdit->text().toInt();
+   if ( params.width < 1 )
+      params.width = 1;
+   params.offsetBits = quint64( qMax( m_ui.m_offsetLineEdit->text().toLongLong(), Q_INT64_C( 0 ) ) ) * 8 +
+                       quint64( qBound( 0, m_ui.m_offsetBitsSpinBox->value(), 7 ) );
 
    m_redBitCount = m_ui.m_redBitsSpinBox->value();
    m_greenBitCount = m_ui.m_greenBitsSpinBox->value();
    m_blueBitCount = m_ui.m_blueBitsSpinBox->value();
    m_grayBitCount = m_ui.m_grayBitsSpinBox->value();
 
-   if ( m_imager )
-   {
-      std::vector< QImage* >   imgVec;
+   params.redBitCount = m_redBitCount;
+   params.greenBitCount = m_greenBitCount;
+   params.blueBitCount = m_blueBitCount;
+   params.grayBitCount = m_grayBitCount;
+   params.order = m_channelOrder;
+   params.alphaBitCount = m_ui.m_alphaBitsSpinBox->value();
+   params.alphaFirst = m_ui.m_alphaFirstCheckBox->isChecked();
+   params.byteOrder = m_ui.m_littleEndianCheckBox->isChecked() ? LP::Imager::LittleEndian : LP::Imager::BigEndian;
+   params.bitOrder = m_ui.m_lsbFirstCheckBox->isChecked() ? LP::Imager::LsbFirst : LP::Imager::MsbFirst;
+   params.planar = m_ui.m_planarCheckBox->isChecked();
+
+   return params;
+}
 
-      m_imager->regenerate( m_redBitCount, m_greenBitCount, 
-            m_blueBitCount, m_grayBitCount, m_channelOrder,
-            width, offset, imgVec );
 
-      QLayout* layout = m_imagePreviewFrame->layout();
-      for ( size_t i = 0; i < m_displayedLabels.size(); ++i )
-      {
-         layout->removeWidget( m_displayedLabels[i] );
-         delete m_displayedLabels[i];
-      }
-      m_displayedLabels.clear();
 
-      delete layout;
+void MainWindow::exportImages( const QString& filename, bool singleImage,
+                               LP::TiffWriter::Compression compression )
+{
+   if ( ! m_imager )
+      return;
 
-      layout = new QVBoxLayout( m_imagePreviewFrame );
-      layout->setSpacing( 1 );
+   LP::Exporter      exporter( *m_imager, currentParams() );
+   QProgressDialog   progress( tr("Exporting %1").arg( filename ), tr("Cancel"), 0, 1, this );
 
-      for ( size_t i = 0; i < imgVec.size(); ++i )
-      {
-         QLabel*  stats = new QLabel( m_imagePreviewFrame );
-         stats->setText( tr("Image %1 (of %2): %3 x %4")
-                           .arg( i+1 )
-                           .arg( imgVec.size() )
-                           .arg( imgVec[i]->width() )
-                           .arg( imgVec[i]->height() ) );
-         layout->addWidget( stats ); 
-         m_displayedLabels.push_back( stats );
-
-         QLabel*  image( new QLabel( m_imagePreviewFrame ) );
-         image->setPixmap( QPixmap::fromImage( *imgVec[i] ) );
-         layout->addWidget( image );
-         m_displayedLabels.push_back( image );
-      }
-      m_imagePreviewFrame->setLayout( layout );
+   exporter.setSingleImage( singleImage );
+   exporter.setBlockSize( quint64( m_ui.m_blockSizeSlider->value() ) * 1024 * 1024 );
+   exporter.setCompression( compression );
+
+   progress.setWindowTitle( tr("Exporting") );
+   progress.setWindowModality( Qt::WindowModal );
+
+   // The dialog's event processing lets Cancel through while this runs.
+   connect(&exporter,
+      SIGNAL( progress(int, int) ),
+      SLOT(onExportProgress(int, int)));
+
+   connect(&progress,
+      SIGNAL( canceled() ),
+      &exporter,
+      SLOT(cancel()));
+
+   m_exportProgress = &progress;
+   if ( ! exporter.run( filename ) && ! progress.wasCanceled() )
+   {
+      QMessageBox::critical( this, tr("Save Failed"),
+            tr("Could not save file.") + "\n" + exporter.errorString() );
+   }
+   m_exportProgress = NULL;
+}
 
-      if ( ! filename.isEmpty() )
-      {
-         QFileInfo   fi( filename );
-
-         for ( size_t i = 0; i < imgVec.size(); ++i )
-         {
-            QString  fname( fi.absolutePath() + "/" + fi.completeBaseName() + 
-                  QString::number(i+1) + "_of_" + QString::number(imgVec.size()) + "." +
-                  fi.suffix() );
-
-            if ( ! imgVec[i]->save( fname, "TIFF" ) )
-            {
-               QMessageBox::critical( this, tr("Save Failed"),
-                     tr("Could not save file.") );
-            }
-         }
-      }
 
-      for ( size_t i = 0; i < imgVec.size(); ++i )
-         delete imgVec[i];
-      imgVec.clear();
+
+void MainWindow::onExportProgress( int cur, int goal )
+{
+   if ( m_exportProgress )
+   {
+      m_exportProgress->setMaximum( goal );
+      m_exportProgress->setValue( cur );
    }
 }
 
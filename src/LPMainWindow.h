@@ -22,22 +22,30 @@
 #include "ui_MainWindow.h"
 
 #include "LPImager.h"
+#include "LPTiffWriter.h"
 
 
 #include <QDir>
 #include <QFileInfo>
-#include <QBitArray>
 
 #include <map>
 
 // Forward declarations
-class QLabel;
+class QProgressDialog;
 class QShortcut;
 
 
 namespace LPUI
 {
 
+class DataLoader;
+class EntropyStrip;
+class HexInspector;
+class HypothesisGrid;
+class OverviewWidget;
+class PreviewWidget;
+class StridePanel;
+
 
 /**@brief The main application window. */
 class MainWindow : public QMainWindow
@@ -56,9 +64,17 @@ private slots:
    void onOpenActionTriggered();
    /// Responds to File->Export
    void onExportActionTriggered();
+   /// Responds to File->Export Single Image
+   void onExportSingleActionTriggered();
    /// Responds to the user requesting to exit the app.
    void onExitActionTriggered();
 
+   /// Progress and completion of a background load started by File->Open
+   void onLoadProgress(int cur, int goal);
+   void onLoadCanceled();
+   void onLoadFinished();
+   void onExportProgress(int cur, int goal);
+
    void recomputePreview();
 
    void onChannelOrderChanged();
@@ -74,6 +90,22 @@ private slots:
    void onWidthSliderChanged(int);
    void onOffsetLineEditChanged();
    void onOffsetSliderChanged(int);
+   /// Applies the bit part of the offset, carrying into the byte offset
+   /// when stepped past either end of a byte.
+   void onOffsetBitsChanged(int);
+   void onThreadCountChanged(int);
+   void onCacheSizeChanged(int);
+
+   /// Shows the image size and tile cache statistics in the status bar.
+   void updateStatus();
+
+   /// Keeps the overview's outline on the rows the preview shows.
+   void onPreviewScrolled();
+   /// Scrolls the preview to a row picked in the overview.
+   void onOverviewRowActivated( quint64 row );
+   /// Applies the width and channel layout picked in the stride panel or
+   /// the hypothesis grid.
+   void onLayoutChosen( const LP::Imager::RenderParams& params );
 
 signals:
 
@@ -81,16 +113,49 @@ private:
    /**@brief Override of base function. */
    virtual void closeEvent( QCloseEvent* );
 
-   void regenerate( const QString& filename = QString() );
+   /// Asks where to export to; returns an empty string if nothing is loaded
+   /// or the user cancels.
+   QString askExportFilename();
+
+   /**@brief Saves the data as TIFF images named after @a filename: one per
+      block, or just one holding every row if @a singleImage is set.
+   */
+   void exportImages( const QString& filename, bool singleImage = false,
+                      LP::TiffWriter::Compression compression = LP::TiffWriter::NoCompression );
+
+   /// Moves the offset slider to the byte offset in the line edit.
+   void syncOffsetSlider();
+
+   /// Reads the render parameters from the controls.
+   LP::Imager::RenderParams currentParams();
+
+   /// Cancels any load in progress and throws away its result.
+   void abandonLoad();
 
    /// The Designer-generated user interface object.
    Ui::MainWindow		m_ui;
 
-   QFrame*  m_imagePreviewFrame;
-   std::vector< QLabel* >  m_displayedLabels;
+   /// Shows the rows of the data that are scrolled into view.
+   PreviewWidget*  m_preview;
+   /// Minimap of the whole data, in a dock.
+   OverviewWidget* m_overview;
+   /// Proposes row strides, in a dock.
+   StridePanel*    m_stridePanel;
+   /// Thumbnails of the data under other widths and layouts, in a dock.
+   HypothesisGrid* m_hypotheses;
+   /// The bytes and bits under the mouse, in a dock.
+   HexInspector*   m_hexInspector;
+   /// The entropy of the data behind each preview row, beside the preview.
+   EntropyStrip*   m_entropyStrip;
 
    LP::Imager*  m_imager;
 
+   /// The load in progress, if any, and its progress dialog.
+   DataLoader*       m_loader;
+   QProgressDialog*  m_loadProgress;
+   /// The progress dialog of the export in progress, if any.
+   QProgressDialog*  m_exportProgress;
+
    QString    m_sourceFilename;
 
    unsigned char  m_redBitCount, m_greenBitCount, m_blueBitCount, m_grayBitCount;
@@ -0,0 +1,246 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPOverview.h"
+#include "LPProfiler.h"
+
+#include <QMutexLocker>
+
+
+namespace LP
+{
+   namespace
+   {
+      /// Size of @a size after shrinking by 2^@a shift, rounding up.
+      quint64 shrunk( quint64 size, int shift )
+      {
+         return ( size + ( quint64( 1 ) << shift ) - 1 ) >> shift;
+      }
+
+
+      /// Returns @a src with half the rows, each the average of two
+      /// (the last row stands alone if the row count is odd).
+      QImage halveRows( const QImage& src )
+      {
+         const int   w( src.width() );
+         const int   h( int( shrunk( src.height(), 1 ) ) );
+         QImage      dst( w, h, QImage::Format_RGB32 );
+
+         for ( int y = 0; y < h; ++y )
+         {
+            const QRgb*    in0( reinterpret_cast< const QRgb* >( src.constScanLine( 2 * y ) ) );
+            const QRgb*    in1( reinterpret_cast< const QRgb* >(
+                                 src.constScanLine( qMin( 2 * y + 1, src.height() - 1 ) ) ) );
+            QRgb*          out( reinterpret_cast< QRgb* >( dst.scanLine( y ) ) );
+
+            for ( int x = 0; x < w; ++x )
+            {
+               // Average each byte of the two pixels without unpacking them.
+               out[x] = 0xff000000u | ( ( ( in0[x] | in1[x] ) & 0x010101u ) +
+                                        ( ( in0[x] & 0xfefefeu ) >> 1 ) +
+                                        ( ( in1[x] & 0xfefefeu ) >> 1 ) );
+            }
+         }
+         return dst;
+      }
+   }
+
+
+
+   Overview::Overview()
+   : m_width( 0 )
+   , m_rowCount( 0 )
+   , m_rowsDone( 0 )
+   , m_columnShift( 0 )
+   , m_rowShift( 0 )
+   , m_freshLevels( 0 )
+   , m_bytes( 0 )
+   {
+   }
+
+
+   Overview::~Overview()
+   {
+      Profiler::instance().adjustCounter( "overview bytes", -m_bytes );
+   }
+
+
+   void Overview::reset( unsigned int width, quint64 rowCount )
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      m_width = width;
+      m_rowCount = rowCount;
+      m_rowsDone = 0;
+      m_levels.clear();
+      m_freshLevels = 0;
+      Profiler::instance().adjustCounter( "overview bytes", -m_bytes );
+      m_bytes = 0;
+
+      if ( width == 0 || rowCount == 0 )
+         return;
+
+      m_columnShift = 0;
+      while ( shrunk( width, m_columnShift ) > quint64( MaxColumns ) )
+         ++m_columnShift;
+
+      const quint64  columns( shrunk( width, m_columnShift ) );
+
+      m_rowShift = 0;
+      while ( columns * shrunk( rowCount, m_rowShift ) > quint64( MaxPixels ) )
+         ++m_rowShift;
+
+      QImage   level( int( columns ), int( shrunk( rowCount, m_rowShift ) ), QImage::Format_RGB32 );
+
+      level.fill( 0xff000000u );
+      m_levels.push_back( level );
+
+      // The coarser levels are only counted here; they are made from
+      // level 0 when first asked for.
+      for ( int s = m_rowShift; shrunk( rowCount, s ) > quint64( MinLevelRows ); ++s )
+      {
+         m_levels.push_back( QImage() );
+         m_bytes += qint64( columns * shrunk( rowCount, s + 1 ) ) * 4;
+      }
+      m_bytes += level.byteCount();
+      Profiler::instance().adjustCounter( "overview bytes", m_bytes );
+
+      m_sums.assign( level.width() * 3, 0 );
+      m_freshLevels = 1;
+   }
+
+
+   void Overview::accumulate( const QImage& rows, int rowCount )
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      if ( m_levels.empty() )
+         return;
+
+      const int   blockRows( 1 << m_rowShift );
+      const int   blockCols( 1 << m_columnShift );
+      const int   levelWidth( m_levels[0].width() );
+
+      for ( int j = 0; j < rowCount && m_rowsDone < m_rowCount; ++j )
+      {
+         const QRgb*    in( reinterpret_cast< const QRgb* >( rows.constScanLine( j ) ) );
+
+         for ( unsigned int x = 0; x < m_width; ++x )
+         {
+            quint32*    sum( &m_sums[ ( x >> m_columnShift ) * 3 ] );
+
+            sum[0] += qRed( in[x] );
+            sum[1] += qGreen( in[x] );
+            sum[2] += qBlue( in[x] );
+         }
+
+         ++m_rowsDone;
+
+         // Finish the level 0 row once its last full-size row is in.
+         if ( m_rowsDone % blockRows == 0 || m_rowsDone == m_rowCount )
+         {
+            const quint32  rows( quint32( m_rowsDone - 1 ) % blockRows + 1 );
+            QRgb*          out( reinterpret_cast< QRgb* >(
+                                 m_levels[0].scanLine( int( ( m_rowsDone - 1 ) >> m_rowShift ) ) ) );
+
+            for ( int x = 0; x < levelWidth; ++x )
+            {
+               const quint32  cols( quint32( qMin( ( x + 1 ) * blockCols, int( m_width ) ) -
+                                             x * blockCols ) );
+               const quint32  n( rows * cols );
+               quint32*       sum( &m_sums[ x * 3 ] );
+
+               out[x] = qRgb( ( sum[0] + n / 2 ) / n, ( sum[1] + n / 2 ) / n, ( sum[2] + n / 2 ) / n );
+               sum[0] = sum[1] = sum[2] = 0;
+            }
+         }
+      }
+
+      m_freshLevels = 1;
+   }
+
+
+   unsigned int Overview::width() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return m_width;
+   }
+
+
+   quint64 Overview::rowCount() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return m_rowCount;
+   }
+
+
+   quint64 Overview::rowsDone() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return m_rowsDone;
+   }
+
+
+   int Overview::columnShift() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return m_columnShift;
+   }
+
+
+   int Overview::rowShift() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return m_rowShift;
+   }
+
+
+   int Overview::levelCount() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return int( m_levels.size() );
+   }
+
+
+   QImage Overview::level( int level ) const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      if ( level < 0 || level >= int( m_levels.size() ) )
+         return QImage();
+
+      refreshLevels( level );
+      return m_levels[ level ];
+   }
+
+
+   void Overview::refreshLevels( int level ) const
+   {
+      for ( ; m_freshLevels <= level; ++m_freshLevels )
+         m_levels[ m_freshLevels ] = halveRows( m_levels[ m_freshLevels - 1 ] );
+   }
+
+
+}  // namespace LP
@@ -0,0 +1,103 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPOVERVIEW_H
+#define LPOVERVIEW_H
+
+#include <QImage>
+#include <QMutex>
+
+#include <vector>
+
+
+namespace LP
+{
+
+
+/**@brief A pyramid of ever shorter, box-filtered copies of a render of the
+   whole data, for finding one's way around a big file.
+
+   Level 0 is the finest level kept: the full-size render shrunk by
+   2^columnShift() across, to at most MaxColumns, and by 2^rowShift()
+   down, so that it has at most MaxPixels.  Each further level has half
+   the rows of the one before it; the columns stay, since an overview is
+   much taller than it is wide.  The full-size rows are fed in once, in
+   order, with accumulate(); the levels can be read (from any thread)
+   while that is going on, and rows that haven't been fed in yet are black.
+*/
+class Overview
+{
+public:
+   /// The most pixels level 0 may have, and the most columns.
+   enum { MaxPixels = 4 * 1024 * 1024, MaxColumns = 256 };
+   /// Levels stop once one is no taller than this.
+   enum { MinLevelRows = 64 };
+
+   Overview();
+   ~Overview();
+
+   /// Starts over for a render @a width pixels wide and @a rowCount rows tall.
+   void reset( unsigned int width, quint64 rowCount );
+
+   /// Adds @a rows full-size rows, which must be the next ones after those
+   /// already added.
+   void accumulate( const QImage& rows, int rowCount );
+
+   /// Width and height of the full-size render.
+   unsigned int width() const;
+   quint64 rowCount() const;
+   /// How many full-size rows have been added so far.
+   quint64 rowsDone() const;
+
+   /// Each level 0 pixel covers 2^columnShift() full-size columns and
+   /// 2^rowShift() full-size rows; each later level twice as many rows.
+   int columnShift() const;
+   int rowShift() const;
+   int levelCount() const;
+   /// Returns a copy of level @a level (0 is the finest).
+   QImage level( int level ) const;
+
+private:
+   /// Regenerates levels 1 .. @a level from level 0 if rows were added
+   /// since they were last made.  m_mutex must be held.
+   void refreshLevels( int level ) const;
+
+   mutable QMutex    m_mutex;
+
+   unsigned int      m_width;
+   quint64           m_rowCount;
+   quint64           m_rowsDone;
+   int               m_columnShift, m_rowShift;
+
+   /// Per-channel sums for the level 0 row being accumulated.
+   std::vector< quint32 >  m_sums;
+
+   mutable std::vector< QImage >   m_levels;
+   /// Levels below this one are up to date with level 0.
+   mutable int       m_freshLevels;
+
+   /// Memory all of the levels take once made, as told to the profiler.
+   qint64            m_bytes;
+};
+
+
+}  // namespace LP
+
+#endif   // LPOVERVIEW_H
+
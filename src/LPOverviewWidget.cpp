@@ -0,0 +1,308 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPOverviewWidget.h"
+#include "LPOverview.h"
+#include "LPProfiler.h"
+
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QWheelEvent>
+
+
+namespace LPUI
+{
+   namespace
+   {
+      /// How long (ms) the parameters must stay put before a build starts.
+      const int   StartDelay( 300 );
+      /// How often (ms) a build in progress is shown.
+      const int   RefreshInterval( 250 );
+   }
+
+
+   /// Builds an overview off the GUI thread.
+   class OverviewBuilder : public Worker
+   {
+   public:
+      OverviewBuilder( LP::Imager* imgr, const LP::Imager::RenderParams& params,
+                       LP::Overview* overview )
+         : m_imager( imgr )
+         , m_params( params )
+         , m_overview( overview )
+      { }
+
+      virtual void run()
+      {
+         m_imager->buildOverview( m_params, *m_overview, cancelFlag() );
+      }
+
+   private:
+      LP::Imager*                m_imager;
+      LP::Imager::RenderParams   m_params;
+      LP::Overview*              m_overview;
+   };
+
+
+
+OverviewWidget::OverviewWidget( QWidget* parent )
+: QWidget( parent )
+, m_imager( NULL )
+, m_overview( new LP::Overview() )
+, m_zoom( 1 )
+, m_topRow( 0 )
+, m_viewFirst( 0 )
+, m_viewCount( 0 )
+{
+   setAttribute( Qt::WA_OpaquePaintEvent );
+
+   m_startTimer.setSingleShot( true );
+   m_startTimer.setInterval( StartDelay );
+   m_refreshTimer.setInterval( RefreshInterval );
+
+   connect(&m_startTimer,
+      SIGNAL(timeout()),
+      SLOT(onStartTimeout()));
+
+   connect(&m_refreshTimer,
+      SIGNAL(timeout()),
+      SLOT(onRefreshTimeout()));
+
+   connect(&m_builder,
+      SIGNAL(finished(LPUI::Worker*)),
+      SLOT(onBuilderFinished(LPUI::Worker*)));
+}
+
+
+OverviewWidget::~OverviewWidget()
+{
+   stopBuild();
+   delete m_overview;
+}
+
+
+
+QSize OverviewWidget::sizeHint() const
+{
+   return QSize( 128, 256 );
+}
+
+
+
+void OverviewWidget::setSource( LP::Imager* imager, const LP::Imager::RenderParams& params )
+{
+   if ( imager == m_imager && params == m_params )
+      return;
+
+   stopBuild();
+   m_overview->reset( 0, 0 );
+
+   if ( imager != m_imager )
+   {
+      m_zoom = 1;
+      m_topRow = 0;
+   }
+
+   m_imager = imager;
+   m_params = params;
+
+   if ( imager )
+      m_startTimer.start();
+   update();
+}
+
+
+
+void OverviewWidget::setViewRows( quint64 firstRow, quint64 rowCount )
+{
+   m_viewFirst = firstRow;
+   m_viewCount = rowCount;
+   update();
+}
+
+
+
+void OverviewWidget::stopBuild()
+{
+   m_startTimer.stop();
+   m_refreshTimer.stop();
+   m_builder.stop();
+}
+
+
+
+void OverviewWidget::onStartTimeout()
+{
+   if ( ! m_imager || m_builder.worker() )
+      return;
+
+   // The overview is a nicety; interactive rendering comes first.
+   m_builder.start( new OverviewBuilder( m_imager, m_params, m_overview ), QThread::LowPriority );
+   m_refreshTimer.start();
+}
+
+
+
+void OverviewWidget::onRefreshTimeout()
+{
+   update();
+}
+
+
+
+void OverviewWidget::onBuilderFinished( LPUI::Worker* )
+{
+   m_refreshTimer.stop();
+   update();
+}
+
+
+
+quint64 OverviewWidget::visibleRows() const
+{
+   const quint64  rowCount( m_imager ? m_imager->rowCount( m_params ) : 0 );
+
+   return qMax( quint64( 1 ), rowCount / m_zoom );
+}
+
+
+
+void OverviewWidget::clampTopRow()
+{
+   const quint64  rowCount( m_imager ? m_imager->rowCount( m_params ) : 0 );
+   const quint64  shown( visibleRows() );
+
+   if ( m_topRow + shown > rowCount )
+      m_topRow = rowCount > shown ? rowCount - shown : 0;
+}
+
+
+
+quint64 OverviewWidget::rowAt( int y ) const
+{
+   const quint64  rowCount( m_imager ? m_imager->rowCount( m_params ) : 0 );
+   const quint64  row( m_topRow + quint64( qMax( y, 0 ) ) * visibleRows() / quint64( qMax( height(), 1 ) ) );
+
+   return rowCount ? qMin( row, rowCount - 1 ) : 0;
+}
+
+
+
+void OverviewWidget::paintEvent( QPaintEvent* event )
+{
+   LP::ScopedTimer   timer( "paint overview" );
+   QPainter painter( this );
+
+   painter.fillRect( event->rect(), palette().dark() );
+
+   const int      levelCount( m_overview->levelCount() );
+   const quint64  shown( visibleRows() );
+
+   if ( levelCount == 0 || height() == 0 )
+      return;
+
+   // Use the coarsest level that still has a row for every pixel of
+   // height (or the finest there is, if none does).
+   const int   rowShift( m_overview->rowShift() );
+   int         level( 0 );
+
+   while ( level + 1 < levelCount &&
+           ( shown >> ( rowShift + level + 1 ) ) >= quint64( height() ) )
+      ++level;
+
+   const QImage   img( m_overview->level( level ) );
+   const int      shift( rowShift + level );
+   const QRectF   source( 0, double( m_topRow ) / ( quint64( 1 ) << shift ),
+                          img.width(), double( shown ) / ( quint64( 1 ) << shift ) );
+
+   painter.drawImage( QRectF( rect() ), img, source );
+
+   // Outline the rows the preview shows.
+   if ( m_viewCount > 0 )
+   {
+      const double   scale( double( height() ) / shown );
+      const double   top( ( double( m_viewFirst ) - double( m_topRow ) ) * scale );
+      const double   h( qMax( double( m_viewCount ) * scale, 2.0 ) );
+
+      painter.setPen( Qt::yellow );
+      painter.drawRect( QRectF( 0.5, top + 0.5, width() - 1.0, h - 1.0 ) );
+   }
+}
+
+
+
+void OverviewWidget::mousePressEvent( QMouseEvent* event )
+{
+   if ( event->button() == Qt::LeftButton && m_imager )
+      emit rowActivated( rowAt( event->y() ) );
+}
+
+
+
+void OverviewWidget::mouseMoveEvent( QMouseEvent* event )
+{
+   if ( ( event->buttons() & Qt::LeftButton ) && m_imager )
+      emit rowActivated( rowAt( qBound( 0, event->y(), height() - 1 ) ) );
+}
+
+
+
+void OverviewWidget::wheelEvent( QWheelEvent* event )
+{
+   if ( ! m_imager )
+      return;
+
+   const quint64  rowCount( m_imager->rowCount( m_params ) );
+   const bool     up( event->delta() > 0 );
+
+   if ( event->modifiers() & Qt::ControlModifier )
+   {
+      // Zoom by two, keeping the row under the pointer where it is.
+      const quint64  anchor( rowAt( event->y() ) );
+      const quint64  oldShown( visibleRows() );
+
+      if ( up && rowCount / ( m_zoom * 2 ) >= quint64( qMax( height(), 1 ) ) )
+         m_zoom *= 2;
+      else if ( ! up && m_zoom > 1 )
+         m_zoom /= 2;
+
+      const quint64  offset( quint64( qMax( event->y(), 0 ) ) * visibleRows() /
+                             quint64( qMax( height(), 1 ) ) );
+
+      if ( visibleRows() != oldShown )
+         m_topRow = anchor > offset ? anchor - offset : 0;
+   }
+   else
+   {
+      const quint64  step( qMax( quint64( 1 ), visibleRows() / 8 ) );
+
+      if ( up )
+         m_topRow = m_topRow > step ? m_topRow - step : 0;
+      else
+         m_topRow += step;
+   }
+
+   clampTopRow();
+   update();
+   event->accept();
+}
+
+
+}  // namespace LPUI
@@ -0,0 +1,130 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPOVERVIEWWIDGET_H
+#define LPOVERVIEWWIDGET_H
+
+#include "LPImager.h"
+#include "LPWorker.h"
+
+#include <QTimer>
+#include <QWidget>
+
+
+namespace LP
+{
+class Overview;
+}
+
+
+namespace LPUI
+{
+
+
+/**@brief A zoomable minimap of the whole data.
+
+   The whole render is squeezed into the widget (each way independently),
+   drawn from the coarsest level of an LP::Overview that still has enough
+   rows for the part shown, so zooming never decodes anything.  The
+   overview is built in the background once the data or the render
+   parameters stop changing, and fills in as it goes.
+
+   The mouse wheel scrolls, Ctrl+wheel zooms around the pointer, and
+   clicking or dragging picks the row to show in the main preview.  The
+   rows the preview currently shows are outlined.
+*/
+class OverviewWidget : public QWidget
+{
+   Q_OBJECT
+
+public:
+   /// Standard constructor
+   OverviewWidget( QWidget* parent = 0 );
+   /// Standard destructor
+   virtual ~OverviewWidget();
+
+   /**@brief Builds an overview of the data of @a imager rendered with
+      @a params, or shows nothing if @a imager is NULL.
+
+      The previous Imager is no longer used once this returns, so it may
+      then be deleted.
+   */
+   void setSource( LP::Imager* imager, const LP::Imager::RenderParams& params );
+
+   /// Outlines rows @a firstRow .. @a firstRow + @a rowCount - 1.
+   void setViewRows( quint64 firstRow, quint64 rowCount );
+
+   /**@brief Override of base function. */
+   virtual QSize sizeHint() const;
+
+signals:
+   /// Emitted when the user picks @a row to be shown.
+   void rowActivated( quint64 row );
+
+protected:
+   /**@brief Override of base function. */
+   virtual void paintEvent( QPaintEvent* event );
+   /**@brief Override of base function. */
+   virtual void mousePressEvent( QMouseEvent* event );
+   /**@brief Override of base function. */
+   virtual void mouseMoveEvent( QMouseEvent* event );
+   /**@brief Override of base function. */
+   virtual void wheelEvent( QWheelEvent* event );
+
+private slots:
+   void onStartTimeout();
+   void onRefreshTimeout();
+   void onBuilderFinished( LPUI::Worker* worker );
+
+private:
+   /// Stops (and throws away) the build in progress, if any.
+   void stopBuild();
+
+   /// Number of rows shown at the current zoom.
+   quint64 visibleRows() const;
+   /// Keeps m_topRow within the data.
+   void clampTopRow();
+   /// The row at widget height @a y.
+   quint64 rowAt( int y ) const;
+
+   LP::Imager*                m_imager;
+   LP::Imager::RenderParams   m_params;
+
+   LP::Overview*     m_overview;
+   /// Runs the build in progress, if any.
+   WorkerOwner       m_builder;
+
+   /// Delays a build until the parameters settle.
+   QTimer            m_startTimer;
+   /// Repaints now and then while a build is in progress.
+   QTimer            m_refreshTimer;
+
+   /// Magnification; the whole data is shown at 1.
+   quint64           m_zoom;
+   /// First row shown.
+   quint64           m_topRow;
+
+   quint64           m_viewFirst, m_viewCount;
+};
+
+
+}  // namespace LPUI
+
+#endif   // LPOVERVIEWWIDGET_H
+
@@ -0,0 +1,441 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "LPPixelDecoders.h"
+#include "LPSimdRows.h"
+
+
+namespace LP
+{
+   namespace
+   {
+      /// The byte count of a @a bits-bit value whose bytes must be swapped
+      /// for @a params, or 0.
+      unsigned int swappedBytes( const Imager::RenderParams& params, unsigned int bits )
+      {
+         // A stream packed least significant bit first is naturally
+         // little-endian, and one packed most significant bit first
+         // big-endian; only the other combination swaps anything.
+         const bool  swap( ( params.byteOrder == Imager::LittleEndian ) !=
+                           ( params.bitOrder == Imager::LsbFirst ) );
+
+         return swap && bits > 8 && bits % 8 == 0 ? bits / 8 : 0;
+      }
+   }
+
+
+
+   PixelLayout::PixelLayout( const Imager::RenderParams& params, quint64 rowCount )
+   : redBitCount( qMin( params.redBitCount, unsigned( MaxFieldBits ) ) )
+   , greenBitCount( qMin( params.greenBitCount, unsigned( MaxFieldBits ) ) )
+   , blueBitCount( qMin( params.blueBitCount, unsigned( MaxFieldBits ) ) )
+   , grayBitCount( qMin( params.grayBitCount, unsigned( MaxFieldBits ) ) )
+   , alphaBitCount( qMin( params.alphaBitCount, unsigned( MaxFieldBits ) ) )
+   , order( params.order )
+   , alphaFirst( params.alphaFirst )
+   , bitOrder( params.bitOrder )
+   , planar( params.planar )
+   , fieldCount( 0 )
+   , swapBytes( 0 )
+   , firstRowBit( params.offsetBits )
+   , rowBits( 0 )
+   , width( params.width )
+   {
+      // A pixel has to consume at least one bit.
+      if ( order == Imager::Grayscale )
+      {
+         if ( grayBitCount < 1 )
+            grayBitCount = 1;
+      }
+      else if ( redBitCount + greenBitCount + blueBitCount < 1 )
+         redBitCount = 1;
+
+      // The fields in stream order, and where each one goes in a QRgb.
+      unsigned int   bits[4];
+      QRgb           multipliers[4];
+
+      if ( alphaBitCount > 0 && alphaFirst )
+      {
+         bits[ fieldCount ] = alphaBitCount;
+         multipliers[ fieldCount++ ] = 1u << 24;
+      }
+
+      if ( order == Imager::Grayscale )
+      {
+         bits[ fieldCount ] = grayBitCount;
+         multipliers[ fieldCount++ ] = 0x010101u;
+      }
+      else
+      {
+         const unsigned int   channelBits[3] = { redBitCount, greenBitCount, blueBitCount };
+         unsigned int         channel[3];
+
+         Decoders::streamChannels( order, channel );
+         for ( int i = 0; i < 3; ++i )
+         {
+            bits[ fieldCount ] = channelBits[ channel[i] ];
+            multipliers[ fieldCount++ ] = 1u << ( 16 - 8 * channel[i] );
+         }
+      }
+
+      if ( alphaBitCount > 0 && ! alphaFirst )
+      {
+         bits[ fieldCount ] = alphaBitCount;
+         multipliers[ fieldCount++ ] = 1u << 24;
+      }
+
+      const unsigned int   bpp( bitsPerPixel() );
+      unsigned int         before( 0 );
+      quint64              planeBit( params.offsetBits );
+
+      for ( unsigned int i = 0; i < fieldCount; ++i )
+      {
+         Field&   f( fields[i] );
+
+         f.bits = bits[i];
+         f.mask = f.bits ? ~quint64( 0 ) >> ( 64 - f.bits ) : 0;
+         f.narrow = f.bits > 8 ? f.bits - 8 : 0;
+         f.scale = scaleTable( qMin( f.bits, 8u ) );
+         f.multiplier = multipliers[i];
+         f.swapBytes = planar ? swappedBytes( params, f.bits ) : 0;
+
+         // The first field is at the top of a pixel read most significant
+         // bit first, and at the bottom of one read least significant
+         // bit first.
+         if ( planar )
+            f.shift = 0;
+         else if ( bitOrder == Imager::MsbFirst )
+            f.shift = bpp - before - f.bits;
+         else
+            f.shift = before;
+         before += f.bits;
+
+         planeStart[i] = planeBit;
+         planeBit += rowCount * width * f.bits;
+      }
+
+      if ( ! planar )
+         swapBytes = swappedBytes( params, bpp );
+      rowBits = quint64( width ) * bpp;
+   }
+
+
+   unsigned int PixelLayout::bitsPerPixel() const
+   {
+      const unsigned int   alpha( alphaBitCount );
+
+      if ( order == Imager::Grayscale )
+         return grayBitCount + alpha;
+      return redBitCount + greenBitCount + blueBitCount + alpha;
+   }
+
+
+   bool PixelLayout::isPlain() const
+   {
+      const unsigned int   widest( order == Imager::Grayscale ? grayBitCount :
+                                   qMax( redBitCount, qMax( greenBitCount, blueBitCount ) ) );
+
+      return ! planar && alphaBitCount == 0 && bitOrder == Imager::MsbFirst &&
+             swapBytes == 0 && widest <= 8;
+   }
+
+
+
+   void PixelLayout::sourceBits( quint64 row, unsigned int column,
+                                 std::vector< Imager::SourceBit >& bits ) const
+   {
+      const unsigned int   bpp( bitsPerPixel() );
+      const quint64        pixel( row * width + column );
+
+      for ( unsigned int i = 0; i < fieldCount; ++i )
+      {
+         const Field&   f( fields[i] );
+         // A field is read as part of the whole pixel, or as a sample of
+         // its own when planar.
+         const quint64        start( planar ? planeStart[i] + pixel * f.bits
+                                            : firstRowBit + row * rowBits + quint64( column ) * bpp );
+         const unsigned int   valueBits( planar ? f.bits : bpp );
+         const unsigned int   swapped( planar ? f.swapBytes : swapBytes );
+         Imager::SourceBit    source;
+
+         source.channel = f.multiplier == 1u << 24 ? 'A' : f.multiplier == 0x010101u ? 'Y' :
+                          f.multiplier == 1u << 16 ? 'R' : f.multiplier == 1u << 8 ? 'G' : 'B';
+
+         for ( unsigned int b = f.bits; b-- > 0; )
+         {
+            // Undo the byte swap, then the read, to find the bit in the stream.
+            unsigned int   v( f.shift + b );
+
+            if ( swapped )
+               v = ( swapped - 1 - v / 8 ) * 8 + v % 8;
+
+            const quint64  pos( bitOrder == Imager::MsbFirst ? start + valueBits - 1 - v : start + v );
+
+            source.byte = pos / 8;
+            source.bit = bitOrder == Imager::MsbFirst ? 7 - unsigned( pos % 8 ) : unsigned( pos % 8 );
+            bits.push_back( source );
+         }
+      }
+   }
+
+
+
+   void Decoders::streamChannels( Imager::ChannelOrder order, unsigned int channel[3] )
+   {
+      switch ( order )
+      {
+      case Imager::RGB: channel[0] = Red;   channel[1] = Green; channel[2] = Blue;  break;
+      case Imager::RBG: channel[0] = Red;   channel[1] = Blue;  channel[2] = Green; break;
+      case Imager::GBR: channel[0] = Green; channel[1] = Blue;  channel[2] = Red;   break;
+      case Imager::GRB: channel[0] = Green; channel[1] = Red;   channel[2] = Blue;  break;
+      case Imager::BGR: channel[0] = Blue;  channel[1] = Green; channel[2] = Red;   break;
+      default:          channel[0] = Blue;  channel[1] = Red;   channel[2] = Green; break;
+      }
+   }
+
+
+
+   namespace
+   {
+      /// Reads the next @a bpp (1..64) bits as one value.
+      inline quint64 readPixel( BitReader& bits, unsigned int bpp, bool lsb )
+      {
+         if ( bpp <= unsigned( BitReader::MaxFieldBits ) )
+            return lsb ? bits.readLsb( bpp ) : bits.read( bpp );
+
+         // Too wide for one read; take it in two.
+         if ( lsb )
+         {
+            const quint64  low( bits.readLsb( 32 ) );
+            return ( bits.readLsb( bpp - 32 ) << 32 ) | low;
+         }
+
+         const quint64  high( bits.read( bpp - 32 ) );
+         return ( high << 32 ) | bits.read( 32 );
+      }
+
+
+      /// Decodes a row of a planar layout, one plane at a time.
+      void decodePlanarRow( BitReader& bits, QRgb* dst, unsigned int width,
+                            const PixelLayout& layout )
+      {
+         // Row positions are given as if the data were packed; the row
+         // index finds the row in each plane.
+         const quint64  row( ( bits.position() - layout.firstRowBit ) / layout.rowBits );
+         const bool     lsb( layout.bitOrder == Imager::LsbFirst );
+
+         for ( unsigned int x = 0; x < width; ++x )
+            dst[x] = 0xff000000u;
+
+         for ( unsigned int i = 0; i < layout.fieldCount; ++i )
+         {
+            const PixelLayout::Field&  f( layout.fields[i] );
+            BitReader                  plane( bits );
+
+            plane.seek( layout.planeStart[i] + row * layout.width * f.bits );
+            for ( unsigned int x = 0; x < width; ++x )
+            {
+               quint64  v( lsb ? plane.readLsb( f.bits ) : plane.read( f.bits ) );
+
+               if ( f.swapBytes )
+                  v = Decoders::swapBytes( v, f.swapBytes );
+               dst[x] |= Decoders::field( v, f );
+            }
+         }
+
+         bits.skip( layout.rowBits );
+      }
+   }
+
+
+   void decodeGenericRow( BitReader& bits, QRgb* dst, unsigned int width,
+                          const PixelLayout& layout )
+   {
+      if ( layout.planar )
+      {
+         decodePlanarRow( bits, dst, width, layout );
+         return;
+      }
+
+      const unsigned int   bpp( layout.bitsPerPixel() );
+      const bool           lsb( layout.bitOrder == Imager::LsbFirst );
+
+      for ( unsigned int x = 0; x < width; ++x )
+      {
+         quint64  v( readPixel( bits, bpp, lsb ) );
+         QRgb     px( 0xff000000u );
+
+         if ( layout.swapBytes )
+            v = Decoders::swapBytes( v, layout.swapBytes );
+         for ( unsigned int i = 0; i < layout.fieldCount; ++i )
+            px |= Decoders::field( v, layout.fields[i] );
+         dst[x] = px;
+      }
+   }
+
+
+
+   namespace
+   {
+      struct DecoderEntry
+      {
+         unsigned int            red, green, blue;
+         Imager::ChannelOrder    order;
+         RowDecoder              decoder;
+      };
+
+#define LP_PACKED_DECODERS( R, G, B ) \
+      { R, G, B, Imager::RGB, &decodePackedRow< R, G, B, Imager::RGB > }, \
+      { R, G, B, Imager::RBG, &decodePackedRow< R, G, B, Imager::RBG > }, \
+      { R, G, B, Imager::GBR, &decodePackedRow< R, G, B, Imager::GBR > }, \
+      { R, G, B, Imager::GRB, &decodePackedRow< R, G, B, Imager::GRB > }, \
+      { R, G, B, Imager::BGR, &decodePackedRow< R, G, B, Imager::BGR > }, \
+      { R, G, B, Imager::BRG, &decodePackedRow< R, G, B, Imager::BRG > }
+
+      /// The layouts that get their own compiled kernel.
+      const DecoderEntry   s_packedDecoders[] =
+      {
+         LP_PACKED_DECODERS( 1, 1, 1 ),
+         LP_PACKED_DECODERS( 2, 2, 2 ),
+         LP_PACKED_DECODERS( 3, 3, 2 ),
+         LP_PACKED_DECODERS( 3, 2, 3 ),
+         LP_PACKED_DECODERS( 2, 3, 3 ),
+         LP_PACKED_DECODERS( 4, 4, 4 ),
+         LP_PACKED_DECODERS( 5, 5, 5 ),
+         LP_PACKED_DECODERS( 5, 6, 5 ),
+         LP_PACKED_DECODERS( 8, 8, 8 )
+      };
+
+#undef LP_PACKED_DECODERS
+
+      struct FormatEntry
+      {
+         unsigned int   bpp, fields;
+         bool           swap, lsb;
+         RowDecoder     decoder;
+      };
+
+#define LP_FORMAT_DECODERS( BPP, FIELDS ) \
+      { BPP, FIELDS, false, false, &decodeFormatRow< BPP, FIELDS, false, false > }, \
+      { BPP, FIELDS, false, true,  &decodeFormatRow< BPP, FIELDS, false, true > }
+
+#define LP_SWAPPED_FORMAT_DECODERS( BPP, FIELDS ) \
+      LP_FORMAT_DECODERS( BPP, FIELDS ), \
+      { BPP, FIELDS, true,  false, &decodeFormatRow< BPP, FIELDS, true, false > }, \
+      { BPP, FIELDS, true,  true,  &decodeFormatRow< BPP, FIELDS, true, true > }
+
+      /// The pixel sizes and field counts of the other layouts that get
+      /// their own compiled kernel: gray of 8 to 16 bits, gray with alpha,
+      /// color of 8 to 48 bits with or without alpha.
+      const FormatEntry    s_formatDecoders[] =
+      {
+         LP_FORMAT_DECODERS( 8, 1 ),
+         LP_FORMAT_DECODERS( 10, 1 ),
+         LP_FORMAT_DECODERS( 12, 1 ),
+         LP_FORMAT_DECODERS( 14, 1 ),
+         LP_SWAPPED_FORMAT_DECODERS( 16, 1 ),
+         LP_SWAPPED_FORMAT_DECODERS( 16, 2 ),
+         LP_SWAPPED_FORMAT_DECODERS( 32, 2 ),
+         LP_FORMAT_DECODERS( 8, 3 ),
+         LP_SWAPPED_FORMAT_DECODERS( 16, 3 ),
+         LP_SWAPPED_FORMAT_DECODERS( 24, 3 ),
+         LP_FORMAT_DECODERS( 30, 3 ),
+         LP_SWAPPED_FORMAT_DECODERS( 32, 3 ),
+         LP_FORMAT_DECODERS( 36, 3 ),
+         LP_SWAPPED_FORMAT_DECODERS( 48, 3 ),
+         LP_SWAPPED_FORMAT_DECODERS( 16, 4 ),
+         LP_SWAPPED_FORMAT_DECODERS( 32, 4 )
+      };
+
+#undef LP_SWAPPED_FORMAT_DECODERS
+#undef LP_FORMAT_DECODERS
+
+
+      /// The compiled kernel for a layout that isn't plain, or the generic one.
+      RowDecoder selectFormatRowDecoder( const PixelLayout& layout )
+      {
+         const unsigned int   bpp( layout.bitsPerPixel() );
+         const bool           lsb( layout.bitOrder == Imager::LsbFirst );
+
+         if ( layout.planar )
+            return &decodeGenericRow;
+
+         for ( size_t i = 0; i < sizeof( s_formatDecoders ) / sizeof( s_formatDecoders[0] ); ++i )
+         {
+            const FormatEntry&   e( s_formatDecoders[i] );
+
+            if ( e.bpp == bpp && e.fields == layout.fieldCount &&
+                 e.swap == ( layout.swapBytes != 0 ) && e.lsb == lsb )
+               return e.decoder;
+         }
+
+         return &decodeGenericRow;
+      }
+
+
+      const RowDecoder  s_grayDecoders[] =
+      {
+         NULL,
+         &decodeGrayRow< 1 >,
+         &decodeGrayRow< 2 >,
+         NULL,
+         &decodeGrayRow< 4 >,
+         NULL,
+         NULL,
+         NULL,
+         &decodeGrayRow< 8 >
+      };
+   }
+
+
+   RowDecoder selectRowDecoder( const PixelLayout& layout )
+   {
+      RowDecoder  decoder( selectSimdRowDecoder( layout, simdLevel() ) );
+
+      if ( ! decoder )
+         decoder = selectScalarRowDecoder( layout );
+      return decoder;
+   }
+
+
+   RowDecoder selectScalarRowDecoder( const PixelLayout& layout )
+   {
+      if ( ! layout.isPlain() )
+         return selectFormatRowDecoder( layout );
+
+      if ( layout.order == Imager::Grayscale )
+      {
+         if ( layout.grayBitCount <= 8 && s_grayDecoders[ layout.grayBitCount ] )
+            return s_grayDecoders[ layout.grayBitCount ];
+         return &decodeGenericRow;
+      }
+
+      for ( size_t i = 0; i < sizeof( s_packedDecoders ) / sizeof( s_packedDecoders[0] ); ++i )
+      {
+         const DecoderEntry&  e( s_packedDecoders[i] );
+
+         if ( e.order == layout.order && e.red == layout.redBitCount &&
+              e.green == layout.greenBitCount && e.blue == layout.blueBitCount )
+            return e.decoder;
+      }
+
+      return &decodeGenericRow;
+   }
+
+
+}  // namespace LP
@@ -0,0 +1,299 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef LPPIXELDECODERS_H
+#define LPPIXELDECODERS_H
+
+#include "LPBitReader.h"
+#include "LPImager.h"
+
+#include <QRgb>
+
+
+namespace LP
+{
+
+
+/**@brief How the bits of one pixel are laid out in the source data, and
+   the plan for decoding them that is worked out from that once per render.
+
+   A pixel is up to four fields (channels) in stream order: gray, or red,
+   green and blue in the given order, plus an optional alpha (or padding)
+   field before or after them.  Each field is 0..16 bits, and fields
+   wider than 8 bits keep their top 8 bits.  Fields are packed pixel by
+   pixel, or planar: every field in a plane of its own, the planes one
+   after the other.  A pixel or sample that is a whole number of bytes
+   may have its bytes swapped.
+*/
+struct PixelLayout
+{
+   /// The widest field.
+   enum { MaxFieldBits = 16 };
+
+   /**@brief The layout of @a params.  The planes of a planar layout are
+      placed for @a rowCount rows (the rows the data makes).
+   */
+   explicit PixelLayout( const Imager::RenderParams& params, quint64 rowCount = 0 );
+
+   /// Number of source bits consumed per pixel.
+   unsigned int bitsPerPixel() const;
+
+   /// Whether the fixed kernels apply: packed gray or R/G/B fields of up
+   /// to 8 bits, most significant bit first, no alpha, no byte swapping.
+   bool isPlain() const;
+
+   /// Appends where each bit of the pixel at @a row, @a column lies in the
+   /// data (see Imager::pixelBits()).
+   void sourceBits( quint64 row, unsigned int column,
+                    std::vector< Imager::SourceBit >& bits ) const;
+
+   unsigned int            redBitCount, greenBitCount, blueBitCount, grayBitCount, alphaBitCount;
+   Imager::ChannelOrder    order;
+   bool                    alphaFirst;
+   Imager::BitOrder        bitOrder;
+   bool                    planar;
+
+   /// How one field is turned into its share of a QRgb.
+   struct Field
+   {
+      unsigned int   bits;
+      /// Position of the field's lowest bit within the pixel value (0 when planar).
+      unsigned int   shift;
+      quint64        mask;
+      /// Bits dropped from the bottom of a field wider than 8 bits.
+      unsigned int   narrow;
+      /// Scales the (narrowed) field to 0..255.
+      const uchar*   scale;
+      /// Moves the scaled value into place; alpha lands in the top byte,
+      /// which is then set opaque.
+      QRgb           multiplier;
+      /// Planar only: bytes of a sample to reverse, or 0.
+      unsigned int   swapBytes;
+   };
+
+   /// The fields in stream order.
+   Field          fields[4];
+   unsigned int   fieldCount;
+   /// Packed only: bytes of a pixel to reverse before splitting it, or 0.
+   unsigned int   swapBytes;
+
+   /// Planar only: where the plane of each field starts, where the first
+   /// row starts and how far apart rows are in the (virtual) packed stream
+   /// that row positions are given in.
+   quint64        planeStart[4];
+   quint64        firstRowBit;
+   quint64        rowBits;
+   unsigned int   width;
+};
+
+
+/**@brief Decodes @a width pixels starting at the reader's position into
+   @a dst (one Format_RGB32 scanline), leaving the reader just past them.
+*/
+typedef void (*RowDecoder)( BitReader& bits, QRgb* dst, unsigned int width,
+                            const PixelLayout& layout );
+
+/**@brief Returns the fastest decoder for @a layout: a vectorized or
+   specialized kernel for the common layouts, or the generic one for
+   anything else.
+*/
+RowDecoder selectRowDecoder( const PixelLayout& layout );
+
+/// Like selectRowDecoder, but never returns a vectorized kernel.
+RowDecoder selectScalarRowDecoder( const PixelLayout& layout );
+
+/// The decoder that handles every layout, a field at a time.
+void decodeGenericRow( BitReader& bits, QRgb* dst, unsigned int width,
+                       const PixelLayout& layout );
+
+
+
+namespace Decoders
+{
+   /// Output channel indices; the shift into a QRgb is 16 - 8 * index.
+   enum { Red = 0, Green = 1, Blue = 2 };
+
+   /// The channels of each ChannelOrder, in the order they appear in the data.
+   template< Imager::ChannelOrder O > struct OrderTraits;
+   template<> struct OrderTraits< Imager::RGB > { static const int C0 = Red,   C1 = Green, C2 = Blue;  };
+   template<> struct OrderTraits< Imager::RBG > { static const int C0 = Red,   C1 = Blue,  C2 = Green; };
+   template<> struct OrderTraits< Imager::GBR > { static const int C0 = Green, C1 = Blue,  C2 = Red;   };
+   template<> struct OrderTraits< Imager::GRB > { static const int C0 = Green, C1 = Red,   C2 = Blue;  };
+   template<> struct OrderTraits< Imager::BGR > { static const int C0 = Blue,  C1 = Green, C2 = Red;   };
+   template<> struct OrderTraits< Imager::BRG > { static const int C0 = Blue,  C1 = Red,   C2 = Green; };
+
+   /// Fills @a channel with the channels of @a order (not Grayscale), in the
+   /// order they appear in the data.
+   void streamChannels( Imager::ChannelOrder order, unsigned int channel[3] );
+
+   /// Reverses the low @a byteCount bytes of @a v.
+   inline quint64 swapBytes( quint64 v, unsigned int byteCount )
+   {
+      return qbswap( v ) >> ( 64 - 8 * byteCount );
+   }
+
+   /// The share of pixel value @a v that field @a f contributes to a QRgb.
+   inline QRgb field( quint64 v, const PixelLayout::Field& f )
+   {
+      return f.multiplier * f.scale[ ( ( v >> f.shift ) & f.mask ) >> f.narrow ];
+   }
+
+   /// Assembles the QRgb of pixel value @a v from its @a Count fields.
+   template< unsigned int Count >
+   inline QRgb pixel( quint64 v, const PixelLayout::Field* fields )
+   {
+      QRgb  px( 0 );
+
+      for ( unsigned int i = 0; i < Count; ++i )
+         px |= field( v, fields[i] );
+      return px | 0xff000000u;
+   }
+
+   /// Scales a @a Bits-bit field to 0..255 and moves it to channel @a C.
+   template< int Bits, int C >
+   inline QRgb channel( quint64 v, const uchar* scale )
+   {
+      const quint64 mask( ( quint64( 1 ) << Bits ) - 1 );
+      return QRgb( Bits == 8 ? ( v & mask ) : scale[ v & mask ] ) << ( 16 - 8 * C );
+   }
+}
+
+
+/**@brief Row kernel for packed R/G/B channels of fixed widths and order.
+
+   With every width known at compile time, as many whole pixels as fit in
+   one BitReader fetch are read at once and split with constant shifts, so
+   the inner loop unrolls completely.
+*/
+template< int R, int G, int B, Imager::ChannelOrder O >
+void decodePackedRow( BitReader& bits, QRgb* dst, unsigned int width, const PixelLayout& )
+{
+   typedef Decoders::OrderTraits< O >  Order;
+
+   static const int  C0 = Order::C0, C1 = Order::C1, C2 = Order::C2;
+   static const int  B0 = C0 == Decoders::Red ? R : C0 == Decoders::Green ? G : B;
+   static const int  B1 = C1 == Decoders::Red ? R : C1 == Decoders::Green ? G : B;
+   static const int  B2 = C2 == Decoders::Red ? R : C2 == Decoders::Green ? G : B;
+   static const int  Bpp = B0 + B1 + B2;
+   static const int  PerRead = BitReader::MaxFieldBits / Bpp;
+
+   const uchar*   s0( scaleTable( B0 ) );
+   const uchar*   s1( scaleTable( B1 ) );
+   const uchar*   s2( scaleTable( B2 ) );
+   unsigned int   x( 0 );
+
+   for ( ; x + PerRead <= width; x += PerRead )
+   {
+      quint64  v( bits.read( PerRead * Bpp ) );
+
+      for ( int k = PerRead - 1; k >= 0; --k )
+      {
+         dst[x + k] = 0xff000000u |
+                      Decoders::channel< B2, C2 >( v, s2 ) |
+                      Decoders::channel< B1, C1 >( v >> B2, s1 ) |
+                      Decoders::channel< B0, C0 >( v >> ( B2 + B1 ), s0 );
+         v >>= Bpp;
+      }
+   }
+
+   for ( ; x < width; ++x )
+   {
+      quint64  v( bits.read( Bpp ) );
+
+      dst[x] = 0xff000000u |
+               Decoders::channel< B2, C2 >( v, s2 ) |
+               Decoders::channel< B1, C1 >( v >> B2, s1 ) |
+               Decoders::channel< B0, C0 >( v >> ( B2 + B1 ), s0 );
+   }
+}
+
+
+/**@brief Row kernel for grayscale pixels of a fixed width (1..8 bits). */
+template< int Bits >
+void decodeGrayRow( BitReader& bits, QRgb* dst, unsigned int width, const PixelLayout& )
+{
+   static const int  PerRead = BitReader::MaxFieldBits / Bits;
+
+   const uchar*   scale( scaleTable( Bits ) );
+   unsigned int   x( 0 );
+
+   for ( ; x + PerRead <= width; x += PerRead )
+   {
+      quint64  v( bits.read( PerRead * Bits ) );
+
+      for ( int k = PerRead - 1; k >= 0; --k )
+      {
+         dst[x + k] = 0xff000000u | 0x010101u * Decoders::channel< Bits, Decoders::Blue >( v, scale );
+         v >>= Bits;
+      }
+   }
+
+   for ( ; x < width; ++x )
+      dst[x] = 0xff000000u | 0x010101u * Decoders::channel< Bits, Decoders::Blue >( bits.read( Bits ), scale );
+}
+
+
+/**@brief Row kernel for packed pixels of a fixed size and field count,
+   read in either bit order and optionally byte-swapped.
+
+   The layout's field table does the splitting, but with the pixel size,
+   field count and orderings fixed at compile time the loops unroll and
+   as many pixels as fit are fetched per read, as in decodePackedRow.
+*/
+template< int Bpp, unsigned int Fields, bool Swap, bool Lsb >
+void decodeFormatRow( BitReader& bits, QRgb* dst, unsigned int width, const PixelLayout& layout )
+{
+   static const int     PerRead = BitReader::MaxFieldBits / Bpp;
+   static const quint64 Mask = ( quint64( 1 ) << Bpp ) - 1;
+
+   // A local copy, which the stores to dst can't alias, stays in registers.
+   PixelLayout::Field   fields[ Fields ];
+   unsigned int         x( 0 );
+
+   for ( unsigned int i = 0; i < Fields; ++i )
+      fields[i] = layout.fields[i];
+
+   for ( ; x + PerRead <= width; x += PerRead )
+   {
+      const quint64  v( Lsb ? bits.readLsb( PerRead * Bpp ) : bits.read( PerRead * Bpp ) );
+
+      for ( int k = 0; k < PerRead; ++k )
+      {
+         quint64  p( ( v >> ( Bpp * ( Lsb ? k : PerRead - 1 - k ) ) ) & Mask );
+
+         if ( Swap )
+            p = Decoders::swapBytes( p, Bpp / 8 );
+         dst[x + k] = Decoders::pixel< Fields >( p, fields );
+      }
+   }
+
+   for ( ; x < width; ++x )
+   {
+      quint64  p( Lsb ? bits.readLsb( Bpp ) : bits.read( Bpp ) );
+
+      if ( Swap )
+         p = Decoders::swapBytes( p, Bpp / 8 );
+      dst[x] = Decoders::pixel< Fields >( p, fields );
+   }
+}
+
+
+}  // namespace LP
+
+#endif   // LPPIXELDECODERS_H
+
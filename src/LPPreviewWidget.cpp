@@ -0,0 +1,233 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPPreviewWidget.h"
+#include "LPProfiler.h"
+#include "LPRenderScheduler.h"
+
+#include <QImage>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+
+
+namespace LPUI
+{
+   namespace
+   {
+      /// Fewest rows rendered beyond each edge of the visible area.
+      const int   MinPrefetchRows( 64 );
+   }
+
+
+
+PreviewWidget::PreviewWidget( QWidget* parent )
+: QWidget( parent )
+, m_scheduler( new RenderScheduler( this ) )
+, m_imager( NULL )
+, m_rowCount( 0 )
+, m_rows( NULL )
+, m_rowsFirst( 0 )
+, m_requested( false )
+, m_requestedFirst( 0 )
+, m_requestedCount( 0 )
+{
+   // Everything is painted by hand, blank areas included.
+   setAttribute( Qt::WA_OpaquePaintEvent );
+   setMouseTracking( true );
+
+   connect(m_scheduler,
+      SIGNAL( rendered(QImage*, const LP::Imager::RenderParams&, quint64) ),
+      SLOT(onRowsRendered(QImage*, const LP::Imager::RenderParams&, quint64)));
+
+   resize( 0, 0 );
+}
+
+
+PreviewWidget::~PreviewWidget()
+{
+   m_scheduler->cancel();
+   delete m_rows;
+   LP::Profiler::instance().setCounter( "preview image bytes", 0 );
+}
+
+
+
+void PreviewWidget::setSource( LP::Imager* imager, const LP::Imager::RenderParams& params )
+{
+   if ( imager != m_imager )
+   {
+      // Rows of another file are no use, even as a placeholder.
+      m_scheduler->cancel();
+      recycleRows();
+      LP::Profiler::instance().setCounter( "preview image bytes", 0 );
+   }
+   else if ( m_rows )
+      shiftRows( params );
+
+   m_imager = imager;
+   m_params = params;
+   m_rowCount = imager ? imager->rowCount( params ) : 0;
+   m_requested = false;
+
+   // The old rows stay on screen until the new ones arrive.  Qt can't
+   // make a widget taller than QWIDGETSIZE_MAX, so rows past that are
+   // out of reach.
+   resize( imager ? int( params.width ) : 0,
+           int( qMin( m_rowCount, quint64( QWIDGETSIZE_MAX ) ) ) );
+   update();
+}
+
+
+
+void PreviewWidget::shiftRows( const LP::Imager::RenderParams& params )
+{
+   qint64   shift;
+
+   if ( ! params.isRowShiftOf( m_rowsParams, shift ) )
+      return;
+
+   // Row r of the old settings is row r - shift of the new ones, so the
+   // rows on hand stay valid; only those that now fall above row 0 go.
+   const quint64  dropped( shift > 0 && quint64( shift ) > m_rowsFirst ? quint64( shift ) - m_rowsFirst : 0 );
+
+   if ( dropped >= quint64( m_rows->height() ) )
+   {
+      recycleRows();
+      return;
+   }
+
+   if ( dropped > 0 )
+   {
+      QImage*  rest( new QImage( m_rows->copy( 0, int( dropped ), m_rows->width(),
+                                               m_rows->height() - int( dropped ) ) ) );
+
+      recycleRows();
+      m_rows = rest;
+      LP::Profiler::instance().setCounter( "preview image bytes", m_rows->byteCount() );
+   }
+
+   m_rowsFirst = quint64( qint64( m_rowsFirst + dropped ) - shift );
+   m_rowsParams = params;
+}
+
+
+
+void PreviewWidget::recycleRows()
+{
+   if ( m_imager )
+      m_imager->recycle( m_rows );
+   else
+      delete m_rows;
+   m_rows = NULL;
+   LP::Profiler::instance().setCounter( "preview image bytes", 0 );
+}
+
+
+
+void PreviewWidget::paintEvent( QPaintEvent* event )
+{
+   LP::ScopedTimer   timer( "paint preview" );
+   QPainter painter( this );
+
+   painter.fillRect( event->rect(), palette().dark() );
+
+   if ( m_rows )
+   {
+      QRect    target( event->rect().intersected(
+                  QRect( 0, int( m_rowsFirst ), m_rows->width(), m_rows->height() ) ) );
+
+      if ( ! target.isEmpty() )
+         painter.drawImage( target, *m_rows, target.translated( 0, -int( m_rowsFirst ) ) );
+   }
+
+   requestVisibleRows();
+}
+
+
+
+void PreviewWidget::mouseMoveEvent( QMouseEvent* event )
+{
+   // One pixel of the widget is one pixel of the data.
+   if ( m_imager && event->x() >= 0 && event->y() >= 0 &&
+        uint( event->x() ) < m_params.width && quint64( event->y() ) < m_rowCount )
+      emit pixelHovered( quint64( event->y() ), uint( event->x() ) );
+}
+
+
+
+void PreviewWidget::requestVisibleRows()
+{
+   const QRect    visible( visibleRegion().boundingRect() );
+
+   if ( ! m_imager || visible.isEmpty() || m_rowCount == 0 )
+      return;
+
+   const quint64  top( visible.top() );
+   const quint64  bottom( qMin( quint64( visible.bottom() + 1 ), m_rowCount ) );
+
+   if ( m_rows && m_rowsParams == m_params &&
+        m_rowsFirst <= top && m_rowsFirst + m_rows->height() >= bottom )
+      return;
+
+   if ( m_requested && m_requestedFirst <= top && m_requestedFirst + m_requestedCount >= bottom )
+      return;
+
+   // Render half a screen beyond each edge, so that scrolling a little
+   // shows rows that are already there.
+   const quint64  margin( qMax( visible.height() / 2, MinPrefetchRows ) );
+
+   m_requested = true;
+   m_requestedFirst = top > margin ? top - margin : 0;
+   m_requestedCount = uint( qMin( bottom + margin, m_rowCount ) - m_requestedFirst );
+
+   m_scheduler->request( m_imager, m_params, m_requestedFirst, m_requestedCount );
+}
+
+
+
+void PreviewWidget::onRowsRendered( QImage* image, const LP::Imager::RenderParams& params,
+                                    quint64 firstRow )
+{
+   if ( params != m_params )
+   {
+      // Rendered for settings that have since changed.
+      if ( m_imager )
+         m_imager->recycle( image );
+      else
+         delete image;
+      return;
+   }
+
+   if ( m_requested && firstRow == m_requestedFirst )
+      m_requested = false;
+
+   // The old rows' pixels are reused by the next render of the same size.
+   recycleRows();
+   m_rows = image;
+   m_rowsParams = params;
+   m_rowsFirst = firstRow;
+   LP::Profiler::instance().setCounter( "preview image bytes", m_rows->byteCount() );
+   update();
+
+   emit rowsRendered();
+}
+
+
+}  // namespace LPUI
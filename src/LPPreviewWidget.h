@@ -0,0 +1,116 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPPREVIEWWIDGET_H
+#define LPPREVIEWWIDGET_H
+
+#include "LPImager.h"
+
+#include <QWidget>
+
+
+namespace LPUI
+{
+
+class RenderScheduler;
+
+
+/**@brief Shows the data as one tall image, one pixel row per data row.
+
+   Only the rows that intersect the visible part of the widget (plus a
+   margin above and below it, so that short scrolls need no new render)
+   are ever decoded, so memory use and render time follow the size of the
+   viewport rather than the size of the file.  Rows are rendered in the
+   background; rows that haven't arrived yet are left blank.  The widget
+   is meant to sit inside a QScrollArea that does not resize it.
+*/
+class PreviewWidget : public QWidget
+{
+   Q_OBJECT
+
+public:
+   /// Standard constructor
+   PreviewWidget( QWidget* parent = 0 );
+   /// Standard destructor
+   virtual ~PreviewWidget();
+
+   /**@brief Shows the data of @a imager rendered with @a params, or nothing
+      if @a imager is NULL.
+
+      The previous Imager is no longer used once this returns, so it may
+      then be deleted.
+   */
+   void setSource( LP::Imager* imager, const LP::Imager::RenderParams& params );
+
+   /// Number of rows the current source makes.
+   quint64 rowCount() const { return m_rowCount; }
+
+signals:
+   /// Emitted whenever newly rendered rows have been put on screen.
+   void rowsRendered();
+
+   /// Emitted as the mouse moves over the pixel at @a row, @a column.
+   void pixelHovered( quint64 row, unsigned int column );
+
+protected:
+   /**@brief Override of base function. */
+   virtual void paintEvent( QPaintEvent* event );
+   /**@brief Override of base function. */
+   virtual void mouseMoveEvent( QMouseEvent* event );
+
+private slots:
+   void onRowsRendered( QImage* image, const LP::Imager::RenderParams& params,
+                        quint64 firstRow );
+
+private:
+   /// Asks for the visible rows to be rendered unless they already are
+   /// (or are on their way).
+   void requestVisibleRows();
+
+   /// Gives the rows on hand back to the Imager that rendered them.
+   void recycleRows();
+
+   /// If @a params only moves the offset of the rows on hand by whole
+   /// rows, renumbers them to match, so that they stay on screen and
+   /// need not be rendered again.
+   void shiftRows( const LP::Imager::RenderParams& params );
+
+   RenderScheduler*  m_scheduler;
+
+   LP::Imager*                m_imager;
+   LP::Imager::RenderParams   m_params;
+   quint64                    m_rowCount;
+
+   /// The most recently rendered rows, which start at row m_rowsFirst and
+   /// were rendered with m_rowsParams.
+   QImage*                    m_rows;
+   LP::Imager::RenderParams   m_rowsParams;
+   quint64                    m_rowsFirst;
+
+   /// The rows last asked for, if that render hasn't been delivered yet.
+   bool                       m_requested;
+   quint64                    m_requestedFirst;
+   unsigned int               m_requestedCount;
+};
+
+
+}  // namespace LPUI
+
+#endif   // LPPREVIEWWIDGET_H
+
@@ -0,0 +1,225 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPProfiler.h"
+
+#include <QByteArray>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <string.h>
+
+
+namespace LP
+{
+   namespace
+   {
+      /// Returns the index of the entry of @a items named @a name, or -1.
+      template< typename T >
+      int findNamed( const std::vector< T >& items, const char* name )
+      {
+         for ( size_t i = 0; i < items.size(); ++i )
+         {
+            // The same literal may live at different addresses in
+            // different translation units.
+            if ( items[i].name == name || strcmp( items[i].name, name ) == 0 )
+               return int( i );
+         }
+         return -1;
+      }
+
+
+      /// Trace timestamps are in microseconds.
+      QByteArray micros( qint64 ns )
+      {
+         return QByteArray::number( double( ns ) / 1000.0, 'f', 3 );
+      }
+
+
+      QByteArray counterEvent( const char* name, qint64 bytes, qint64 ns )
+      {
+         return QByteArray( "{\"name\":\"" ) + name + "\",\"cat\":\"memory\",\"ph\":\"C\",\"ts\":" +
+                micros( ns ) + ",\"pid\":1,\"args\":{\"bytes\":" + QByteArray::number( bytes ) + "}}";
+      }
+   }
+
+
+
+   Profiler& Profiler::instance()
+   {
+      static Profiler   profiler;
+
+      return profiler;
+   }
+
+
+   Profiler::Profiler()
+   : m_traceEmpty( true )
+   {
+      m_clock.start();
+   }
+
+
+   Profiler::~Profiler()
+   {
+      stopTrace();
+   }
+
+
+
+   void Profiler::record( const char* stage, qint64 startNs, qint64 ns )
+   {
+      QMutexLocker   lock( &m_mutex );
+      int            i( findNamed( m_stages, stage ) );
+
+      if ( i < 0 )
+      {
+         const Stage    fresh = { stage, 0, 0, 0, 0 };
+
+         i = int( m_stages.size() );
+         m_stages.push_back( fresh );
+      }
+
+      Stage*   s( &m_stages[i] );
+
+      ++s->count;
+      s->totalNs += ns;
+      s->lastNs = ns;
+      s->maxNs = qMax( s->maxNs, ns );
+
+      if ( m_trace.isOpen() )
+      {
+         writeEvent( QByteArray( "{\"name\":\"" ) + stage + "\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":" +
+                     micros( startNs ) + ",\"dur\":" + micros( ns ) + ",\"pid\":1,\"tid\":" +
+                     QByteArray::number( quint64( quintptr( QThread::currentThreadId() ) ) ) + "}" );
+      }
+   }
+
+
+   void Profiler::setCounter( const char* counter, qint64 bytes )
+   {
+      updateCounter( counter, bytes, false );
+   }
+
+
+   void Profiler::adjustCounter( const char* counter, qint64 bytes )
+   {
+      updateCounter( counter, bytes, true );
+   }
+
+
+   void Profiler::updateCounter( const char* counter, qint64 bytes, bool relative )
+   {
+      QMutexLocker   lock( &m_mutex );
+      int            i( findNamed( m_counters, counter ) );
+
+      if ( i < 0 )
+      {
+         const Counter  fresh = { counter, 0 };
+
+         i = int( m_counters.size() );
+         m_counters.push_back( fresh );
+      }
+
+      m_counters[i].bytes = relative ? m_counters[i].bytes + bytes : bytes;
+
+      if ( m_trace.isOpen() )
+         writeEvent( counterEvent( counter, m_counters[i].bytes, now() ) );
+   }
+
+
+
+   std::vector< Profiler::Stage > Profiler::stages() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return m_stages;
+   }
+
+
+   std::vector< Profiler::Counter > Profiler::counters() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return m_counters;
+   }
+
+
+   Profiler::Stage Profiler::stage( const char* name ) const
+   {
+      QMutexLocker   lock( &m_mutex );
+      const int      i( findNamed( m_stages, name ) );
+      const Stage    none = { name, 0, 0, 0, 0 };
+
+      return i >= 0 ? m_stages[i] : none;
+   }
+
+
+   qint64 Profiler::counter( const char* name ) const
+   {
+      QMutexLocker   lock( &m_mutex );
+      const int      i( findNamed( m_counters, name ) );
+
+      return i >= 0 ? m_counters[i].bytes : 0;
+   }
+
+
+
+   bool Profiler::startTrace( const QString& filename )
+   {
+      stopTrace();
+
+      QMutexLocker   lock( &m_mutex );
+
+      m_trace.setFileName( filename );
+      if ( ! m_trace.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+         return false;
+
+      m_trace.write( "[\n" );
+      m_traceEmpty = true;
+
+      // Start from the memory already held.
+      for ( size_t i = 0; i < m_counters.size(); ++i )
+         writeEvent( counterEvent( m_counters[i].name, m_counters[i].bytes, now() ) );
+      return true;
+   }
+
+
+   void Profiler::stopTrace()
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      if ( m_trace.isOpen() )
+      {
+         m_trace.write( "\n]\n" );
+         m_trace.close();
+      }
+   }
+
+
+   void Profiler::writeEvent( const QByteArray& event )
+   {
+      if ( ! m_traceEmpty )
+         m_trace.write( ",\n" );
+      m_trace.write( event );
+      m_traceEmpty = false;
+   }
+
+
+}  // namespace LP
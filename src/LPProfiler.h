@@ -0,0 +1,145 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPPROFILER_H
+#define LPPROFILER_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+
+#include <vector>
+
+
+namespace LP
+{
+
+
+/**@brief Collects how long each stage of the pipeline takes and how much
+   memory the big buffers hold.
+
+   Stages are timed with ScopedTimer and counters are set by whoever owns
+   the memory; both are named by string literals.  The totals can be read
+   back at any time (the status bar shows them), and while a trace is
+   being recorded every timed stage and counter change is also written to
+   a Chrome trace file (chrome://tracing, Perfetto).  Safe to use from
+   several threads.
+*/
+class Profiler
+{
+public:
+   struct Stage
+   {
+      const char*    name;
+      quint64        count;
+      /// Total, most recent and longest run, in nanoseconds.
+      qint64         totalNs, lastNs, maxNs;
+   };
+
+   struct Counter
+   {
+      const char*    name;
+      qint64         bytes;
+   };
+
+   /// The one profiler of the process.
+   static Profiler& instance();
+
+   /// Nanoseconds since the profiler was created.
+   qint64 now() const { return m_clock.nsecsElapsed(); }
+
+   /// Adds a run of @a stage that started at @a startNs (see now()) and
+   /// took @a ns nanoseconds.
+   void record( const char* stage, qint64 startNs, qint64 ns );
+
+   /// Sets memory counter @a counter to @a bytes.
+   void setCounter( const char* counter, qint64 bytes );
+   /// Adds @a bytes (which may be negative) to memory counter @a counter,
+   /// for memory that several owners hold a share of.
+   void adjustCounter( const char* counter, qint64 bytes );
+
+   /// Every stage and counter so far, in the order first seen.
+   std::vector< Stage > stages() const;
+   std::vector< Counter > counters() const;
+
+   /// Returns the stage called @a name; its count is 0 if it never ran.
+   Stage stage( const char* name ) const;
+   /// Returns the value of counter @a name, or 0 if it was never set.
+   qint64 counter( const char* name ) const;
+
+   /// Starts writing a Chrome trace to @a filename.
+   bool startTrace( const QString& filename );
+   /// Finishes the trace, if one is being written.
+   void stopTrace();
+
+private:
+   Profiler();
+   ~Profiler();
+
+   /// Sets @a counter to @a bytes, or adds them if @a relative.
+   void updateCounter( const char* counter, qint64 bytes, bool relative );
+
+   /// Writes one trace event (JSON object); m_mutex must be held.
+   void writeEvent( const QByteArray& event );
+
+   mutable QMutex       m_mutex;
+   QElapsedTimer        m_clock;
+   std::vector< Stage >    m_stages;
+   std::vector< Counter >  m_counters;
+
+   QFile                m_trace;
+   bool                 m_traceEmpty;
+};
+
+
+
+/**@brief Times its own lifetime as one run of a stage.
+
+   @code
+   {
+      ScopedTimer timer( "decode tile" );
+      ...
+   }
+   @endcode
+*/
+class ScopedTimer
+{
+public:
+   explicit ScopedTimer( const char* stage )
+   : m_stage( stage )
+   , m_start( Profiler::instance().now() )
+   { }
+
+   ~ScopedTimer()
+   {
+      Profiler&   profiler( Profiler::instance() );
+
+      profiler.record( m_stage, m_start, profiler.now() - m_start );
+   }
+
+private:
+   const char*    m_stage;
+   qint64         m_start;
+};
+
+
+}  // namespace LP
+
+#endif   // LPPROFILER_H
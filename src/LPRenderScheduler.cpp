@@ -0,0 +1,165 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "LPRenderScheduler.h"
+
+#include <QImage>
+
+
+namespace LPUI
+{
+   namespace
+   {
+      /// Requests closer together than this (in ms) are coalesced.
+      const int   DebounceInterval( 30 );
+   }
+
+
+   /// Renders one request off the GUI thread.
+   class RenderWorker : public Worker
+   {
+   public:
+      RenderWorker( LP::Imager* imgr, const LP::Imager::RenderParams& params,
+                    quint64 firstRow, unsigned int rowCount )
+         : m_imager( imgr )
+         , m_params( params )
+         , m_firstRow( firstRow )
+         , m_rowCount( rowCount )
+         , m_image( NULL )
+      { }
+
+      virtual ~RenderWorker()
+      {
+         m_imager->recycle( m_image );
+      }
+
+      virtual void run()
+      {
+         m_image = m_imager->renderRows( m_params, m_firstRow, m_rowCount, cancelFlag() );
+      }
+
+      const LP::Imager::RenderParams& params() const { return m_params; }
+      quint64 firstRow() const { return m_firstRow; }
+
+      /// Hands the rendered image (NULL if there is none) over to the caller.
+      QImage* takeImage()
+      {
+         QImage*  img( m_image );
+         m_image = NULL;
+         return img;
+      }
+
+   private:
+      LP::Imager*                m_imager;
+      LP::Imager::RenderParams   m_params;
+      quint64                    m_firstRow;
+      unsigned int               m_rowCount;
+      QImage*                    m_image;
+   };
+
+
+
+RenderScheduler::RenderScheduler( QObject* parent )
+: QObject( parent )
+, m_pending( false )
+, m_pendingImager( NULL )
+, m_pendingFirstRow( 0 )
+, m_pendingRowCount( 0 )
+{
+   m_debounceTimer.setSingleShot( true );
+   m_debounceTimer.setInterval( DebounceInterval );
+
+   connect(&m_debounceTimer,
+      SIGNAL(timeout()),
+      SLOT(onDebounceTimeout()));
+
+   connect(&m_worker,
+      SIGNAL(finished(LPUI::Worker*)),
+      SLOT(onWorkerFinished(LPUI::Worker*)));
+}
+
+
+RenderScheduler::~RenderScheduler()
+{
+   cancel();
+}
+
+
+
+void RenderScheduler::request( LP::Imager* imager, const LP::Imager::RenderParams& params,
+                               quint64 firstRow, unsigned int rowCount )
+{
+   m_pending = true;
+   m_pendingImager = imager;
+   m_pendingParams = params;
+   m_pendingFirstRow = firstRow;
+   m_pendingRowCount = rowCount;
+
+   // Whatever is being rendered now is already out of date.
+   m_worker.cancel();
+
+   m_debounceTimer.start();
+}
+
+
+
+void RenderScheduler::cancel()
+{
+   m_debounceTimer.stop();
+   m_pending = false;
+   m_pendingImager = NULL;
+   m_worker.stop();
+}
+
+
+
+void RenderScheduler::onDebounceTimeout()
+{
+   startPending();
+}
+
+
+
+void RenderScheduler::onWorkerFinished( LPUI::Worker* worker )
+{
+   RenderWorker*  render( static_cast< RenderWorker* >( worker ) );
+   QImage*        img( render->takeImage() );
+
+   if ( img )
+      emit rendered( img, render->params(), render->firstRow() );
+
+   // A request that came in while the worker was busy waits for the
+   // debounce timer, unless the timer has already gone off.
+   if ( ! m_debounceTimer.isActive() )
+      startPending();
+}
+
+
+
+void RenderScheduler::startPending()
+{
+   if ( ! m_pending || m_worker.worker() )
+      return;
+
+   m_pending = false;
+   m_worker.start( new RenderWorker( m_pendingImager, m_pendingParams,
+                                     m_pendingFirstRow, m_pendingRowCount ) );
+}
+
+
+}  // namespace LPUI
@@ -0,0 +1,91 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef LPRENDERSCHEDULER_H
+#define LPRENDERSCHEDULER_H
+
+#include "LPImager.h"
+#include "LPWorker.h"
+
+#include <QObject>
+#include <QTimer>
+
+
+namespace LPUI
+{
+
+
+/**@brief Renders rows of the preview on a worker thread, one request at a
+   time.
+
+   Requests that arrive in a burst (e.g. while a slider is dragged) are
+   coalesced so that only the most recent one is rendered, and a render
+   that is still running when a new request arrives is cancelled.  The
+   latency seen by the user is therefore bounded by one render, no matter
+   how many requests were made.
+*/
+class RenderScheduler : public QObject
+{
+   Q_OBJECT
+
+public:
+   /// Standard constructor
+   RenderScheduler( QObject* parent = 0 );
+   /// Standard destructor
+   virtual ~RenderScheduler();
+
+   /// Schedules a render of @a rowCount rows of @a imager starting at
+   /// @a firstRow, replacing any render not yet delivered.
+   void request( LP::Imager* imager, const LP::Imager::RenderParams& params,
+                 quint64 firstRow, unsigned int rowCount );
+
+   /**@brief Drops any pending render and waits for the one in progress to
+      stop.  Must be called before the Imager being rendered is deleted.
+   */
+   void cancel();
+
+signals:
+   /// Delivers a finished render of the rows starting at @a firstRow; the
+   /// receiver takes ownership of @a image.
+   void rendered( QImage* image, const LP::Imager::RenderParams& params,
+                  quint64 firstRow );
+
+private slots:
+   void onDebounceTimeout();
+   void onWorkerFinished( LPUI::Worker* worker );
+
+private:
+   /// Starts the pending request if the worker is idle.
+   void startPending();
+
+   QTimer         m_debounceTimer;
+   /// Runs the render in progress, if any.
+   WorkerOwner    m_worker;
+
+   bool                       m_pending;
+   LP::Imager*                m_pendingImager;
+   LP::Imager::RenderParams   m_pendingParams;
+   quint64                    m_pendingFirstRow;
+   unsigned int               m_pendingRowCount;
+};
+
+
+}  // namespace LPUI
+
+#endif   // LPRENDERSCHEDULER_H
+
@@ -0,0 +1,509 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "LPSimdRows.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  define LP_X86_SIMD
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#     include <intrin.h>
+#  endif
+#endif
+
+// GCC and Clang only allow an intrinsic in a function compiled for its
+// instruction set; MSVC allows them anywhere.
+#if defined(__GNUC__)
+#  define LP_TARGET( isa ) __attribute__(( target( isa ) ))
+#else
+#  define LP_TARGET( isa )
+#endif
+
+
+namespace LP
+{
+namespace Simd
+{
+   // Scalar versions of the kernels, used for the pixels left over after
+   // the last full vector.
+
+   inline void gray8Tail( const uchar* src, QRgb* dst, unsigned int x, unsigned int width )
+   {
+      for ( ; x < width; ++x )
+         dst[x] = 0xff000000u | 0x010101u * src[x];
+   }
+
+
+   /// @a pos holds the byte position of red, green and blue within a pixel.
+   inline void rgb888Tail( const uchar* src, QRgb* dst, unsigned int x, unsigned int width,
+                           const unsigned int pos[3] )
+   {
+      for ( ; x < width; ++x )
+      {
+         const uchar*   p( src + 3 * x );
+         dst[x] = 0xff000000u | ( QRgb( p[ pos[0] ] ) << 16 ) |
+                  ( QRgb( p[ pos[1] ] ) << 8 ) | p[ pos[2] ];
+      }
+   }
+
+
+   inline void rgb565Tail( const uchar* src, QRgb* dst, unsigned int x, unsigned int width,
+                           bool bgr )
+   {
+      const uchar*   s5( scaleTable( 5 ) );
+      const uchar*   s6( scaleTable( 6 ) );
+
+      for ( ; x < width; ++x )
+      {
+         unsigned int   w( ( src[2 * x] << 8 ) | src[2 * x + 1] );
+         QRgb           first( s5[ w >> 11 ] ), last( s5[ w & 31 ] );
+
+         dst[x] = 0xff000000u | ( QRgb( bgr ? last : first ) << 16 ) |
+                  ( QRgb( s6[ ( w >> 5 ) & 63 ] ) << 8 ) | ( bgr ? first : last );
+      }
+   }
+
+
+   /// Byte position of red, green and blue within an 8/8/8 pixel.
+   inline void rgb888Positions( Imager::ChannelOrder order, unsigned int pos[3] )
+   {
+      unsigned int   channel[3];
+
+      Decoders::streamChannels( order, channel );
+      for ( unsigned int i = 0; i < 3; ++i )
+         pos[ channel[i] ] = i;
+   }
+
+
+   /// Whether @a layout is 8-bit red, green and blue in any order plus an
+   /// 8-bit alpha (or padding) byte before or after them, packed, in either
+   /// byte or bit order.
+   inline bool isRgb8888( const PixelLayout& layout )
+   {
+      return ! layout.planar && layout.order != Imager::Grayscale && layout.fieldCount == 4 &&
+             layout.redBitCount == 8 && layout.greenBitCount == 8 && layout.blueBitCount == 8 &&
+             layout.alphaBitCount == 8 && ( layout.swapBytes == 0 || layout.swapBytes == 4 );
+   }
+
+
+   /// Byte position of red, green and blue within an 8/8/8/8 pixel.
+   inline void rgb8888Positions( const PixelLayout& layout, unsigned int pos[3] )
+   {
+      // Whole-byte fields land in stream order whichever way bits are
+      // packed; swapping the pixel's bytes reverses that order.
+      for ( unsigned int i = 0; i < 4; ++i )
+      {
+         const unsigned int   byte( layout.swapBytes ? 3 - i : i );
+         const QRgb           multiplier( layout.fields[i].multiplier );
+
+         if ( multiplier == 1u << 16 )
+            pos[0] = byte;
+         else if ( multiplier == 1u << 8 )
+            pos[1] = byte;
+         else if ( multiplier == 1u )
+            pos[2] = byte;
+      }
+   }
+
+
+   inline void rgb8888Tail( const uchar* src, QRgb* dst, unsigned int x, unsigned int width,
+                            const unsigned int pos[3] )
+   {
+      for ( ; x < width; ++x )
+      {
+         const uchar*   p( src + 4 * x );
+         dst[x] = 0xff000000u | ( QRgb( p[ pos[0] ] ) << 16 ) |
+                  ( QRgb( p[ pos[1] ] ) << 8 ) | p[ pos[2] ];
+      }
+   }
+
+
+#if defined(LP_X86_SIMD)
+
+   // The 5 and 6-bit channels of 5/6/5 are scaled to 0..255 with a multiply
+   // and shift that rounds exactly like scaleTable(): (v * 527 + 23) >> 6
+   // and (v * 259 + 33) >> 6.
+
+
+   LP_TARGET( "sse2" )
+   void gray8SSE2( const uchar* src, QRgb* dst, unsigned int width, const PixelLayout& )
+   {
+      const __m128i  alpha( _mm_set1_epi32( int( 0xff000000u ) ) );
+      unsigned int   x( 0 );
+
+      for ( ; x + 16 <= width; x += 16 )
+      {
+         __m128i  v( _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + x ) ) );
+         __m128i  lo( _mm_unpacklo_epi8( v, v ) );
+         __m128i  hi( _mm_unpackhi_epi8( v, v ) );
+         __m128i* out( reinterpret_cast< __m128i* >( dst + x ) );
+
+         _mm_storeu_si128( out,     _mm_or_si128( _mm_unpacklo_epi16( lo, lo ), alpha ) );
+         _mm_storeu_si128( out + 1, _mm_or_si128( _mm_unpackhi_epi16( lo, lo ), alpha ) );
+         _mm_storeu_si128( out + 2, _mm_or_si128( _mm_unpacklo_epi16( hi, hi ), alpha ) );
+         _mm_storeu_si128( out + 3, _mm_or_si128( _mm_unpackhi_epi16( hi, hi ), alpha ) );
+      }
+      gray8Tail( src, dst, x, width );
+   }
+
+
+   LP_TARGET( "avx2" )
+   void gray8AVX2( const uchar* src, QRgb* dst, unsigned int width, const PixelLayout& )
+   {
+      const __m256i  alpha( _mm256_set1_epi32( int( 0xff000000u ) ) );
+      unsigned int   x( 0 );
+
+      for ( ; x + 8 <= width; x += 8 )
+      {
+         __m256i  v( _mm256_cvtepu8_epi32( _mm_loadl_epi64( reinterpret_cast< const __m128i* >( src + x ) ) ) );
+
+         v = _mm256_or_si256( _mm256_or_si256( v, _mm256_slli_epi32( v, 8 ) ),
+                              _mm256_or_si256( _mm256_slli_epi32( v, 16 ), alpha ) );
+         _mm256_storeu_si256( reinterpret_cast< __m256i* >( dst + x ), v );
+      }
+      gray8Tail( src, dst, x, width );
+   }
+
+
+   /// Shuffle mask that turns the first 12 bytes of a vector into 4 pixels.
+   inline void rgb888Shuffle( const unsigned int pos[3], char mask[16] )
+   {
+      for ( int p = 0; p < 4; ++p )
+      {
+         mask[4 * p]     = char( 3 * p + pos[2] );
+         mask[4 * p + 1] = char( 3 * p + pos[1] );
+         mask[4 * p + 2] = char( 3 * p + pos[0] );
+         mask[4 * p + 3] = char( 0x80 );
+      }
+   }
+
+
+   LP_TARGET( "ssse3" )
+   void rgb888SSSE3( const uchar* src, QRgb* dst, unsigned int width, const PixelLayout& layout )
+   {
+      unsigned int   pos[3];
+      char           maskBytes[16];
+
+      rgb888Positions( layout.order, pos );
+      rgb888Shuffle( pos, maskBytes );
+
+      const __m128i  mask( _mm_loadu_si128( reinterpret_cast< const __m128i* >( maskBytes ) ) );
+      const __m128i  alpha( _mm_set1_epi32( int( 0xff000000u ) ) );
+      unsigned int   x( 0 );
+
+      // Each load reads 16 bytes to use 12, so stop two pixels early.
+      for ( ; x + 6 <= width; x += 4 )
+      {
+         __m128i  v( _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + 3 * x ) ) );
+
+         _mm_storeu_si128( reinterpret_cast< __m128i* >( dst + x ),
+                           _mm_or_si128( _mm_shuffle_epi8( v, mask ), alpha ) );
+      }
+      rgb888Tail( src, dst, x, width, pos );
+   }
+
+
+   LP_TARGET( "avx2" )
+   void rgb888AVX2( const uchar* src, QRgb* dst, unsigned int width, const PixelLayout& layout )
+   {
+      unsigned int   pos[3];
+      char           maskBytes[16];
+
+      rgb888Positions( layout.order, pos );
+      rgb888Shuffle( pos, maskBytes );
+
+      const __m128i  mask128( _mm_loadu_si128( reinterpret_cast< const __m128i* >( maskBytes ) ) );
+      const __m256i  mask( _mm256_broadcastsi128_si256( mask128 ) );
+      const __m256i  alpha( _mm256_set1_epi32( int( 0xff000000u ) ) );
+      unsigned int   x( 0 );
+
+      // Two 16-byte loads 12 bytes apart cover 8 pixels and read 4 bytes
+      // past them, so stop two pixels early.
+      for ( ; x + 10 <= width; x += 8 )
+      {
+         const uchar*   p( src + 3 * x );
+         __m256i        v( _mm256_inserti128_si256(
+                              _mm256_castsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i* >( p ) ) ),
+                              _mm_loadu_si128( reinterpret_cast< const __m128i* >( p + 12 ) ), 1 ) );
+
+         _mm256_storeu_si256( reinterpret_cast< __m256i* >( dst + x ),
+                              _mm256_or_si256( _mm256_shuffle_epi8( v, mask ), alpha ) );
+      }
+      rgb888Tail( src, dst, x, width, pos );
+   }
+
+
+   /// Shuffle mask that turns 16 bytes into 4 pixels, dropping the alpha byte.
+   inline void rgb8888Shuffle( const unsigned int pos[3], char mask[16] )
+   {
+      for ( int p = 0; p < 4; ++p )
+      {
+         mask[4 * p]     = char( 4 * p + pos[2] );
+         mask[4 * p + 1] = char( 4 * p + pos[1] );
+         mask[4 * p + 2] = char( 4 * p + pos[0] );
+         mask[4 * p + 3] = char( 0x80 );
+      }
+   }
+
+
+   LP_TARGET( "ssse3" )
+   void rgb8888SSSE3( const uchar* src, QRgb* dst, unsigned int width, const PixelLayout& layout )
+   {
+      unsigned int   pos[3];
+      char           maskBytes[16];
+
+      rgb8888Positions( layout, pos );
+      rgb8888Shuffle( pos, maskBytes );
+
+      const __m128i  mask( _mm_loadu_si128( reinterpret_cast< const __m128i* >( maskBytes ) ) );
+      const __m128i  alpha( _mm_set1_epi32( int( 0xff000000u ) ) );
+      unsigned int   x( 0 );
+
+      for ( ; x + 4 <= width; x += 4 )
+      {
+         __m128i  v( _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + 4 * x ) ) );
+
+         _mm_storeu_si128( reinterpret_cast< __m128i* >( dst + x ),
+                           _mm_or_si128( _mm_shuffle_epi8( v, mask ), alpha ) );
+      }
+      rgb8888Tail( src, dst, x, width, pos );
+   }
+
+
+   LP_TARGET( "avx2" )
+   void rgb8888AVX2( const uchar* src, QRgb* dst, unsigned int width, const PixelLayout& layout )
+   {
+      unsigned int   pos[3];
+      char           maskBytes[16];
+
+      rgb8888Positions( layout, pos );
+      rgb8888Shuffle( pos, maskBytes );
+
+      const __m128i  mask128( _mm_loadu_si128( reinterpret_cast< const __m128i* >( maskBytes ) ) );
+      const __m256i  mask( _mm256_broadcastsi128_si256( mask128 ) );
+      const __m256i  alpha( _mm256_set1_epi32( int( 0xff000000u ) ) );
+      unsigned int   x( 0 );
+
+      // Pixels don't straddle the 128-bit lanes, so one in-lane shuffle does.
+      for ( ; x + 8 <= width; x += 8 )
+      {
+         __m256i  v( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( src + 4 * x ) ) );
+
+         _mm256_storeu_si256( reinterpret_cast< __m256i* >( dst + x ),
+                              _mm256_or_si256( _mm256_shuffle_epi8( v, mask ), alpha ) );
+      }
+      rgb8888Tail( src, dst, x, width, pos );
+   }
+
+
+   LP_TARGET( "sse2" )
+   void rgb565SSE2( const uchar* src, QRgb* dst, unsigned int width, const PixelLayout& layout )
+   {
+      const bool     bgr( layout.order == Imager::BGR );
+      const __m128i  mask5( _mm_set1_epi16( 31 ) ), mask6( _mm_set1_epi16( 63 ) );
+      const __m128i  mul5( _mm_set1_epi16( 527 ) ), add5( _mm_set1_epi16( 23 ) );
+      const __m128i  mul6( _mm_set1_epi16( 259 ) ), add6( _mm_set1_epi16( 33 ) );
+      const __m128i  alpha( _mm_set1_epi16( short( 0xff00 ) ) );
+      unsigned int   x( 0 );
+
+      for ( ; x + 8 <= width; x += 8 )
+      {
+         __m128i  w( _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + 2 * x ) ) );
+
+         // The data is big-endian.
+         w = _mm_or_si128( _mm_slli_epi16( w, 8 ), _mm_srli_epi16( w, 8 ) );
+
+         __m128i  first( _mm_srli_epi16( w, 11 ) );
+         __m128i  mid( _mm_and_si128( _mm_srli_epi16( w, 5 ), mask6 ) );
+         __m128i  last( _mm_and_si128( w, mask5 ) );
+
+         first = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( first, mul5 ), add5 ), 6 );
+         mid = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( mid, mul6 ), add6 ), 6 );
+         last = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( last, mul5 ), add5 ), 6 );
+
+         __m128i  gb( _mm_or_si128( bgr ? first : last, _mm_slli_epi16( mid, 8 ) ) );
+         __m128i  ar( _mm_or_si128( bgr ? last : first, alpha ) );
+         __m128i* out( reinterpret_cast< __m128i* >( dst + x ) );
+
+         _mm_storeu_si128( out,     _mm_unpacklo_epi16( gb, ar ) );
+         _mm_storeu_si128( out + 1, _mm_unpackhi_epi16( gb, ar ) );
+      }
+      rgb565Tail( src, dst, x, width, bgr );
+   }
+
+
+   LP_TARGET( "avx2" )
+   void rgb565AVX2( const uchar* src, QRgb* dst, unsigned int width, const PixelLayout& layout )
+   {
+      const bool     bgr( layout.order == Imager::BGR );
+      const __m256i  mask5( _mm256_set1_epi16( 31 ) ), mask6( _mm256_set1_epi16( 63 ) );
+      const __m256i  mul5( _mm256_set1_epi16( 527 ) ), add5( _mm256_set1_epi16( 23 ) );
+      const __m256i  mul6( _mm256_set1_epi16( 259 ) ), add6( _mm256_set1_epi16( 33 ) );
+      const __m256i  alpha( _mm256_set1_epi16( short( 0xff00 ) ) );
+      unsigned int   x( 0 );
+
+      for ( ; x + 16 <= width; x += 16 )
+      {
+         __m256i  w( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( src + 2 * x ) ) );
+
+         w = _mm256_or_si256( _mm256_slli_epi16( w, 8 ), _mm256_srli_epi16( w, 8 ) );
+
+         __m256i  first( _mm256_srli_epi16( w, 11 ) );
+         __m256i  mid( _mm256_and_si256( _mm256_srli_epi16( w, 5 ), mask6 ) );
+         __m256i  last( _mm256_and_si256( w, mask5 ) );
+
+         first = _mm256_srli_epi16( _mm256_add_epi16( _mm256_mullo_epi16( first, mul5 ), add5 ), 6 );
+         mid = _mm256_srli_epi16( _mm256_add_epi16( _mm256_mullo_epi16( mid, mul6 ), add6 ), 6 );
+         last = _mm256_srli_epi16( _mm256_add_epi16( _mm256_mullo_epi16( last, mul5 ), add5 ), 6 );
+
+         __m256i  gb( _mm256_or_si256( bgr ? first : last, _mm256_slli_epi16( mid, 8 ) ) );
+         __m256i  ar( _mm256_or_si256( bgr ? last : first, alpha ) );
+
+         // The unpacks work within 128-bit lanes; put the pixels back in order.
+         __m256i  lo( _mm256_unpacklo_epi16( gb, ar ) );
+         __m256i  hi( _mm256_unpackhi_epi16( gb, ar ) );
+         __m256i* out( reinterpret_cast< __m256i* >( dst + x ) );
+
+         _mm256_storeu_si256( out,     _mm256_permute2x128_si256( lo, hi, 0x20 ) );
+         _mm256_storeu_si256( out + 1, _mm256_permute2x128_si256( lo, hi, 0x31 ) );
+      }
+      rgb565Tail( src, dst, x, width, bgr );
+   }
+
+#endif   // LP_X86_SIMD
+
+
+   typedef void (*ByteKernel)( const uchar* src, QRgb* dst, unsigned int width,
+                               const PixelLayout& layout );
+
+   /// Runs @a Kernel on the row's bytes if it starts on a byte boundary,
+   /// and the equivalent scalar kernel if not.
+   template< ByteKernel Kernel, int BytesPerPixel >
+   void byteAlignedRow( BitReader& bits, QRgb* dst, unsigned int width, const PixelLayout& layout )
+   {
+      const quint64  byteCount( quint64( width ) * BytesPerPixel );
+      const uchar*   src( bits.alignedBytes( byteCount ) );
+
+      if ( src )
+      {
+         Kernel( src, dst, width, layout );
+         bits.skip( byteCount * 8 );
+      }
+      else
+         selectScalarRowDecoder( layout )( bits, dst, width, layout );
+   }
+
+
+   SimdLevel detectSimdLevel()
+   {
+#if defined(LP_X86_SIMD) && defined(__GNUC__)
+      __builtin_cpu_init();
+      if ( __builtin_cpu_supports( "avx2" ) )
+         return SimdAVX2;
+      if ( __builtin_cpu_supports( "ssse3" ) )
+         return SimdSSSE3;
+      if ( __builtin_cpu_supports( "sse2" ) )
+         return SimdSSE2;
+#elif defined(LP_X86_SIMD) && defined(_MSC_VER)
+      int   info[4];
+
+      __cpuid( info, 0 );
+      const int   maxLeaf( info[0] );
+
+      __cpuid( info, 1 );
+      const bool  sse2( ( info[3] & ( 1 << 26 ) ) != 0 );
+      const bool  ssse3( ( info[2] & ( 1 << 9 ) ) != 0 );
+      const bool  osAvx( ( info[2] & ( 1 << 27 ) ) != 0 && ( info[2] & ( 1 << 28 ) ) != 0 &&
+                         ( _xgetbv( 0 ) & 6 ) == 6 );
+
+      if ( osAvx && maxLeaf >= 7 )
+      {
+         __cpuidex( info, 7, 0 );
+         if ( info[1] & ( 1 << 5 ) )
+            return SimdAVX2;
+      }
+      if ( ssse3 )
+         return SimdSSSE3;
+      if ( sse2 )
+         return SimdSSE2;
+#endif
+      return SimdNone;
+   }
+
+}  // namespace Simd
+
+
+
+   SimdLevel simdLevel()
+   {
+      static const SimdLevel  s_level( Simd::detectSimdLevel() );
+      return s_level;
+   }
+
+
+   RowDecoder selectSimdRowDecoder( const PixelLayout& layout, SimdLevel level )
+   {
+#if defined(LP_X86_SIMD)
+      using namespace Simd;
+
+      if ( isRgb8888( layout ) )
+      {
+         if ( level >= SimdAVX2 )
+            return &byteAlignedRow< &rgb8888AVX2, 4 >;
+         if ( level >= SimdSSSE3 )
+            return &byteAlignedRow< &rgb8888SSSE3, 4 >;
+         return NULL;
+      }
+
+      if ( ! layout.isPlain() )
+         return NULL;
+
+      if ( layout.order == Imager::Grayscale )
+      {
+         if ( layout.grayBitCount == 8 )
+         {
+            if ( level >= SimdAVX2 )
+               return &byteAlignedRow< &gray8AVX2, 1 >;
+            if ( level >= SimdSSE2 )
+               return &byteAlignedRow< &gray8SSE2, 1 >;
+         }
+      }
+      else if ( layout.redBitCount == 8 && layout.greenBitCount == 8 && layout.blueBitCount == 8 )
+      {
+         if ( level >= SimdAVX2 )
+            return &byteAlignedRow< &rgb888AVX2, 3 >;
+         if ( level >= SimdSSSE3 )
+            return &byteAlignedRow< &rgb888SSSE3, 3 >;
+      }
+      else if ( layout.redBitCount == 5 && layout.greenBitCount == 6 && layout.blueBitCount == 5 &&
+                ( layout.order == Imager::RGB || layout.order == Imager::BGR ) )
+      {
+         if ( level >= SimdAVX2 )
+            return &byteAlignedRow< &rgb565AVX2, 2 >;
+         if ( level >= SimdSSE2 )
+            return &byteAlignedRow< &rgb565SSE2, 2 >;
+      }
+#else
+      Q_UNUSED( layout );
+      Q_UNUSED( level );
+#endif
+      return NULL;
+   }
+
+
+}  // namespace LP
@@ -0,0 +1,55 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef LPSIMDROWS_H
+#define LPSIMDROWS_H
+
+#include "LPPixelDecoders.h"
+
+
+namespace LP
+{
+
+
+/// Vector instruction sets the row kernels know how to use, weakest first.
+typedef enum
+{
+   SimdNone, SimdSSE2, SimdSSSE3, SimdAVX2
+} SimdLevel;
+
+
+/// Returns the best instruction set supported by this CPU (detected once).
+SimdLevel simdLevel();
+
+/**@brief Returns a vectorized decoder for @a layout using instructions up to
+   @a level, or NULL if there isn't one.
+
+   Vector kernels exist for the byte-aligned layouts: 8-bit gray, 5/6/5
+   in RGB or BGR order, 8/8/8 in any order, and 8/8/8 plus an alpha byte
+   (RGBA, BGRA, ARGB and the like, in either byte order), whose alpha is
+   dropped.  They read straight from the source bytes when a row starts
+   on a byte boundary and defer to the scalar kernel when it doesn't,
+   producing identical pixels either way.
+*/
+RowDecoder selectSimdRowDecoder( const PixelLayout& layout, SimdLevel level );
+
+
+}  // namespace LP
+
+#endif   // LPSIMDROWS_H
+
@@ -0,0 +1,291 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPStrideDetector.h"
+
+#include <algorithm>
+#include <complex>
+#include <math.h>
+
+
+namespace LP
+{
+   namespace
+   {
+      typedef std::complex< double >   Complex;
+
+      /// Most candidates returned.
+      const size_t   MaxCandidates( 10 );
+      /// Scores below this are taken for noise.
+      const double   MinScore( 0.05 );
+      /// The narrowest rows looked for, in pixels.
+      const int      MinWidth( 8 );
+      /// The largest pixel size looked for, in bytes (8/8/8).
+      const int      MaxPixelBytes( 3 );
+
+      const double   Pi( 3.14159265358979323846 );
+
+
+      /// In-place radix-2 FFT of @a a, whose size must be a power of two.
+      /// The inverse transform is not scaled by 1 / size.
+      void fft( std::vector< Complex >& a, bool inverse )
+      {
+         const size_t   n( a.size() );
+
+         for ( size_t i = 1, j = 0; i < n; ++i )
+         {
+            size_t   bit( n >> 1 );
+
+            for ( ; j & bit; bit >>= 1 )
+               j ^= bit;
+            j ^= bit;
+            if ( i < j )
+               std::swap( a[i], a[j] );
+         }
+
+         for ( size_t len = 2; len <= n; len <<= 1 )
+         {
+            const double   angle( ( inverse ? 2.0 : -2.0 ) * Pi / double( len ) );
+            const Complex  step( cos( angle ), sin( angle ) );
+
+            for ( size_t i = 0; i < n; i += len )
+            {
+               Complex  w( 1.0 );
+
+               for ( size_t k = 0; k < len / 2; ++k )
+               {
+                  const Complex  u( a[i + k] );
+                  const Complex  v( a[i + k + len / 2] * w );
+
+                  a[i + k] = u + v;
+                  a[i + k + len / 2] = u - v;
+                  w *= step;
+               }
+            }
+         }
+      }
+
+
+      /**@brief Autocorrelation of @a signal for shifts 0 .. @a maxLag,
+         scaled so that shift 0 is 1 and corrected for the shrinking
+         overlap at larger shifts.  Empty if the signal is flat or the work
+         was cancelled.
+      */
+      std::vector< double > autocorrelation( const std::vector< double >& signal, int maxLag,
+                                             QAtomicInt* cancel )
+      {
+         const size_t            n( signal.size() );
+         size_t                  m( 1 );
+         std::vector< double >   c;
+
+         // Zero padding to twice the length keeps the correlation linear
+         // rather than circular.
+         while ( m < 2 * n )
+            m <<= 1;
+
+         std::vector< Complex >  a( m );
+
+         std::copy( signal.begin(), signal.end(), a.begin() );
+
+         fft( a, false );
+         if ( cancel && cancel->fetchAndAddRelaxed( 0 ) )
+            return c;
+
+         for ( size_t i = 0; i < m; ++i )
+            a[i] = std::norm( a[i] );
+
+         fft( a, true );
+         if ( ( cancel && cancel->fetchAndAddRelaxed( 0 ) ) || a[0].real() <= 0 )
+            return c;
+
+         c.resize( maxLag + 1 );
+         for ( int k = 0; k <= maxLag; ++k )
+            c[k] = a[k].real() / a[0].real() * double( n ) / double( n - k );
+         return c;
+      }
+
+
+      /// Correlation of @a x with itself @a lag entries along, scaled as
+      /// by autocorrelation(); for the few small shifts needed directly.
+      double correlation( const std::vector< double >& x, size_t lag )
+      {
+         double   sum( 0 ), energy( 0 );
+
+         for ( size_t i = 0; i < x.size(); ++i )
+         {
+            energy += x[i] * x[i];
+            if ( i + lag < x.size() )
+               sum += x[i] * x[i + lag];
+         }
+         return energy > 0 ? sum / energy * double( x.size() ) / double( x.size() - lag ) : 0;
+      }
+
+
+      /// Sets the channels of @a params for pixels of @a pixelBytes bytes,
+      /// keeping the channel order where it still applies.
+      void setPixelBytes( Imager::RenderParams& params, int pixelBytes )
+      {
+         params.alphaBitCount = 0;
+         params.planar = false;
+         if ( pixelBytes == 1 )
+         {
+            params.order = Imager::Grayscale;
+            params.grayBitCount = 8;
+            return;
+         }
+
+         if ( params.order == Imager::Grayscale )
+            params.order = Imager::RGB;
+         params.redBitCount = pixelBytes == 2 ? 5 : 8;
+         params.greenBitCount = pixelBytes == 2 ? 6 : 8;
+         params.blueBitCount = pixelBytes == 2 ? 5 : 8;
+      }
+
+
+      bool betterCandidate( const StrideCandidate& a, const StrideCandidate& b )
+      {
+         return a.score > b.score;
+      }
+   }
+
+
+
+   std::vector< StrideCandidate > detectStrides( const QByteArray& sample,
+                                                 const Imager::RenderParams& base,
+                                                 unsigned int maxWidth,
+                                                 QAtomicInt* cancel )
+   {
+      std::vector< StrideCandidate >   candidates;
+      const int                        n( sample.size() );
+      const uchar*                     bytes( reinterpret_cast< const uchar* >( sample.constData() ) );
+      // A stride must repeat a few times within the sample to show up.
+      const int                        maxStride( n / 4 );
+
+      if ( maxStride < MinWidth * MaxPixelBytes )
+         return candidates;
+
+      std::vector< double >   x( n );
+      double                  mean( 0 );
+
+      for ( int i = 0; i < n; ++i )
+         mean += bytes[i];
+      mean /= n;
+      for ( int i = 0; i < n; ++i )
+         x[i] = bytes[i] - mean;
+
+      // Neighbouring pixels correlate best with the same channel of the
+      // next pixel, which gives away the pixel size.
+      int      pixelBytes( 1 );
+      double   pixelCorrelation[ MaxPixelBytes + 1 ];
+
+      for ( int p = 1; p <= MaxPixelBytes; ++p )
+      {
+         pixelCorrelation[p] = correlation( x, p );
+         if ( pixelCorrelation[p] > pixelCorrelation[ pixelBytes ] )
+            pixelBytes = p;
+      }
+
+      // Smooth content correlates with itself at every nearby shift, which
+      // would swamp the row stride.  The change from one pixel to the next
+      // doesn't: it lines up with itself only a whole row further on,
+      // where the same edges cross.
+      std::vector< double >   change( n - pixelBytes );
+
+      for ( int i = 0; i + pixelBytes < n; ++i )
+         change[i] = x[i + pixelBytes] - x[i];
+
+      const std::vector< double >   c( autocorrelation( change, maxStride + pixelBytes, cancel ) );
+
+      if ( c.empty() )
+         return candidates;
+
+      // Peaks, strongest first.
+      std::vector< std::pair< double, int > >   peaks;
+
+      for ( int k = MinWidth * pixelBytes; k <= maxStride; ++k )
+      {
+         bool  peak( c[k] >= MinScore );
+
+         for ( int j = k - pixelBytes; peak && j <= k + pixelBytes; ++j )
+            peak = j == k || c[j] < c[k] || ( c[j] == c[k] && j > k );
+         if ( peak )
+            peaks.push_back( std::make_pair( c[k], k ) );
+      }
+      std::sort( peaks.rbegin(), peaks.rend() );
+
+      // Whole multiples of a stride (rows two or three apart) peak too;
+      // keep only the stride itself, in the place of its best multiple.
+      std::vector< int >   strides;
+
+      for ( size_t i = 0; i < peaks.size() && strides.size() < MaxCandidates; ++i )
+      {
+         const int   k( peaks[i].second );
+         bool        known( false );
+
+         for ( size_t j = 0; j < strides.size() && ! known; ++j )
+         {
+            if ( k % strides[j] == 0 )
+               known = true;
+            else if ( strides[j] % k == 0 && c[k] > 0.5 * c[ strides[j] ] )
+            {
+               strides[j] = k;
+               known = true;
+            }
+         }
+         if ( ! known )
+            strides.push_back( k );
+      }
+
+      if ( cancel && cancel->fetchAndAddRelaxed( 0 ) )
+         return candidates;
+
+      // Each stride with the likeliest pixel size, then the other sizes it
+      // divides into, ranked by how well they fit.
+      for ( size_t i = 0; i < strides.size(); ++i )
+      {
+         for ( int p = 1; p <= MaxPixelBytes; ++p )
+         {
+            const int   stride( strides[i] );
+
+            if ( stride % p != 0 || unsigned( stride / p ) > maxWidth )
+               continue;
+
+            StrideCandidate   candidate;
+
+            candidate.strideBytes = stride;
+            candidate.params = base;
+            candidate.params.width = stride / p;
+            setPixelBytes( candidate.params, p );
+            candidate.score = qMin( c[ stride ], 1.0 );
+            if ( p != pixelBytes )
+               candidate.score *= pixelCorrelation[ pixelBytes ] > 0
+                  ? 0.5 * qBound( 0.0, pixelCorrelation[p] / pixelCorrelation[ pixelBytes ], 1.0 )
+                  : 0.0;
+            candidates.push_back( candidate );
+         }
+      }
+
+      std::stable_sort( candidates.begin(), candidates.end(), betterCandidate );
+      if ( candidates.size() > MaxCandidates )
+         candidates.resize( MaxCandidates );
+      return candidates;
+   }
+
+
+}  // namespace LP
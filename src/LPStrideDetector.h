@@ -0,0 +1,72 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPSTRIDEDETECTOR_H
+#define LPSTRIDEDETECTOR_H
+
+#include "LPImager.h"
+
+#include <QAtomicInt>
+#include <QByteArray>
+
+#include <vector>
+
+
+namespace LP
+{
+
+
+/**@brief One likely way of laying the data out in rows. */
+struct StrideCandidate
+{
+   /// Bytes from the start of one row to the start of the next.
+   quint64                 strideBytes;
+   /// The render parameters the guess was based on, with the width and
+   /// channel layout that match the stride.
+   Imager::RenderParams    params;
+   /// How strongly rows this far apart resemble each other (0..1).
+   double                  score;
+};
+
+
+/// Bytes of data detectStrides() is meant to look at.
+enum { StrideSampleBytes = 256 * 1024 };
+
+
+/**@brief Guesses the row stride and pixel size of @a sample (raw data,
+   ideally StrideSampleBytes of it), best guess first.
+
+   Rows of an image resemble the rows next to them, so the change from
+   pixel to pixel correlates with itself shifted by one row.  That
+   autocorrelation is computed for every shift at once with an FFT, and
+   its peaks become the stride candidates.  The shift at which the bytes
+   correlate best shows the pixel size: 3 bytes for 8/8/8 data, 2 for
+   5/6/5 and 1 for 8-bit gray.  Each candidate is @a base with the width and
+   channel bits changed to match, and no wider than @a maxWidth.  Returns
+   nothing if cancelled through @a cancel or the sample shows no rows.
+*/
+std::vector< StrideCandidate > detectStrides( const QByteArray& sample,
+                                              const Imager::RenderParams& base,
+                                              unsigned int maxWidth,
+                                              QAtomicInt* cancel = NULL );
+
+
+}  // namespace LP
+
+#endif   // LPSTRIDEDETECTOR_H
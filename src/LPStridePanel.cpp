@@ -0,0 +1,161 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPStridePanel.h"
+
+#include <QLabel>
+#include <QListWidget>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+
+namespace LPUI
+{
+   /// Runs the stride detection off the GUI thread.
+   class StrideWorker : public Worker
+   {
+   public:
+      StrideWorker( LP::Imager* imgr, const LP::Imager::RenderParams& params,
+                    unsigned int maxWidth )
+         : m_imager( imgr )
+         , m_params( params )
+         , m_maxWidth( maxWidth )
+      { }
+
+      virtual void run()
+      {
+         const QByteArray  sample( m_imager->bytes( m_params.offsetBits / 8, LP::StrideSampleBytes ) );
+
+         m_candidates = LP::detectStrides( sample, m_params, m_maxWidth, cancelFlag() );
+      }
+
+      const std::vector< LP::StrideCandidate >& candidates() const { return m_candidates; }
+
+   private:
+      LP::Imager*                         m_imager;
+      LP::Imager::RenderParams            m_params;
+      unsigned int                        m_maxWidth;
+      std::vector< LP::StrideCandidate >  m_candidates;
+   };
+
+
+
+StridePanel::StridePanel( QWidget* parent )
+: QWidget( parent )
+, m_imager( NULL )
+, m_maxWidth( 0xffffffffu )
+, m_detectButton( new QPushButton( tr("Detect"), this ) )
+, m_list( new QListWidget( this ) )
+, m_statusLabel( new QLabel( this ) )
+{
+   QVBoxLayout*   layout( new QVBoxLayout( this ) );
+
+   layout->addWidget( m_detectButton );
+   layout->addWidget( m_list );
+   layout->addWidget( m_statusLabel );
+
+   m_detectButton->setEnabled( false );
+   m_detectButton->setToolTip( tr("Guess the row stride from the data at the current offset") );
+
+   connect(m_detectButton,
+      SIGNAL(clicked()),
+      SLOT(onDetectClicked()));
+
+   connect(m_list,
+      SIGNAL(itemClicked(QListWidgetItem*)),
+      SLOT(onItemClicked(QListWidgetItem*)));
+
+   connect(&m_worker,
+      SIGNAL(finished(LPUI::Worker*)),
+      SLOT(onWorkerFinished(LPUI::Worker*)));
+}
+
+
+StridePanel::~StridePanel()
+{
+   m_worker.stop();
+}
+
+
+
+void StridePanel::setSource( LP::Imager* imager, const LP::Imager::RenderParams& params )
+{
+   const bool  newData( imager != m_imager );
+
+   m_params = params;
+   if ( ! newData )
+      return;
+
+   m_worker.stop();
+   m_imager = imager;
+   m_candidates.clear();
+   m_list->clear();
+   m_statusLabel->clear();
+   m_detectButton->setEnabled( imager != NULL );
+
+   if ( imager )
+      onDetectClicked();
+}
+
+
+
+void StridePanel::onDetectClicked()
+{
+   if ( ! m_imager )
+      return;
+
+   m_list->clear();
+   m_statusLabel->setText( tr("Detecting...") );
+   m_worker.start( new StrideWorker( m_imager, m_params, m_maxWidth ), QThread::LowPriority );
+}
+
+
+
+void StridePanel::onWorkerFinished( LPUI::Worker* worker )
+{
+   m_candidates = static_cast< StrideWorker* >( worker )->candidates();
+
+   m_list->clear();
+   for ( size_t i = 0; i < m_candidates.size(); ++i )
+   {
+      const LP::StrideCandidate&  c( m_candidates[i] );
+
+      m_list->addItem( tr("%1 bytes: %2 x %3 (%4%)")
+                          .arg( c.strideBytes )
+                          .arg( c.params.width )
+                          .arg( c.params.layoutName() )
+                          .arg( int( c.score * 100 + 0.5 ) ) );
+   }
+
+   m_statusLabel->setText( m_candidates.empty() ? tr("No rows found") :
+                                                  tr("Click a stride to use it") );
+}
+
+
+
+void StridePanel::onItemClicked( QListWidgetItem* item )
+{
+   const int   row( m_list->row( item ) );
+
+   if ( row >= 0 && size_t( row ) < m_candidates.size() )
+      emit candidateChosen( m_candidates[ row ].params );
+}
+
+
+}  // namespace LPUI
@@ -0,0 +1,94 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef LPSTRIDEPANEL_H
+#define LPSTRIDEPANEL_H
+
+#include "LPImager.h"
+#include "LPStrideDetector.h"
+#include "LPWorker.h"
+
+#include <QWidget>
+
+#include <vector>
+
+class QLabel;
+class QListWidget;
+class QListWidgetItem;
+class QPushButton;
+
+
+namespace LPUI
+{
+
+
+/**@brief Lists the row strides the data most likely has.
+
+   The data at the current offset is analysed in the background (see
+   LP::detectStrides()) when a file is loaded and whenever Detect is
+   pressed.  Clicking a candidate applies its width and channel layout.
+*/
+class StridePanel : public QWidget
+{
+   Q_OBJECT
+
+public:
+   /// Standard constructor
+   StridePanel( QWidget* parent = 0 );
+   /// Standard destructor
+   virtual ~StridePanel();
+
+   /**@brief Analyses the data of @a imager from the offset of @a params,
+      or shows nothing if @a imager is NULL.
+
+      Detection starts by itself only when @a imager is new.  The previous
+      Imager is no longer used once this returns, so it may then be
+      deleted.
+   */
+   void setSource( LP::Imager* imager, const LP::Imager::RenderParams& params );
+
+   /// The widest rows proposed.
+   void setMaxWidth( unsigned int maxWidth ) { m_maxWidth = maxWidth; }
+
+signals:
+   /// Emitted when the user picks a candidate, with its render parameters.
+   void candidateChosen( const LP::Imager::RenderParams& params );
+
+private slots:
+   void onDetectClicked();
+   void onWorkerFinished( LPUI::Worker* worker );
+   void onItemClicked( QListWidgetItem* item );
+
+private:
+   LP::Imager*                m_imager;
+   LP::Imager::RenderParams   m_params;
+   unsigned int               m_maxWidth;
+
+   /// Runs the detection in progress, if any.
+   WorkerOwner                m_worker;
+   std::vector< LP::StrideCandidate >  m_candidates;
+
+   QPushButton*      m_detectButton;
+   QListWidget*      m_list;
+   QLabel*           m_statusLabel;
+};
+
+
+}  // namespace LPUI
+
+#endif   // LPSTRIDEPANEL_H
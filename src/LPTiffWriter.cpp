@@ -0,0 +1,505 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPTiffWriter.h"
+#include "LPProfiler.h"
+
+#include <QDataStream>
+#include <QImage>
+#include <QObject>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <algorithm>
+
+
+namespace LP
+{
+   namespace
+   {
+      enum FieldType { Short = 3, Long = 4, Rational = 5, Long8 = 16 };
+
+      /// Size in bytes of one value of @a type.
+      int typeSize( quint16 type )
+      {
+         switch ( type )
+         {
+         case Short: return 2;
+         case Long:  return 4;
+         default:    return 8;
+         }
+      }
+
+      /// One directory entry.  A rational takes two values.
+      struct Field
+      {
+         Field( quint16 t, quint16 ty, quint64 value )
+         : tag( t ), type( ty ), count( 1 ), values( 1, value ), offset( 0 )
+         { }
+
+         Field( quint16 t, quint16 ty, const std::vector< quint64 >& v )
+         : tag( t ), type( ty ), count( ty == Rational ? v.size() / 2 : v.size() ), values( v ), offset( 0 )
+         { }
+
+         quint16                 tag, type;
+         quint64                 count;
+         std::vector< quint64 >  values;
+         /// Where the values went, if they didn't fit in the entry.
+         quint64                 offset;
+      };
+
+      void writeValues( QDataStream& out, const Field& f )
+      {
+         for ( size_t i = 0; i < f.values.size(); ++i )
+         {
+            switch ( f.type )
+            {
+            case Short:    out << quint16( f.values[i] ); break;
+            case Long:
+            case Rational: out << quint32( f.values[i] ); break;
+            default:       out << quint64( f.values[i] ); break;
+            }
+         }
+      }
+
+      /// Largest file a classic TIFF can address.
+      const quint64  MaxClassicSize( Q_UINT64_C( 0xffffffff ) );
+
+      /// Compression tag values.
+      const quint16  CompressionCodes[] = { 1, 8, 5 };
+
+      /// LZW codes as TIFF defines them.
+      enum { LzwClear = 256, LzwEnd = 257, LzwFirst = 258, LzwMaxBits = 12 };
+
+
+      /// Appends codes of varying width to a byte array, most significant
+      /// bit first.
+      class CodeWriter
+      {
+      public:
+         CodeWriter( QByteArray& out ) : m_out( out ), m_bits( 0 ), m_bitCount( 0 ) { }
+
+         void put( int code, int width )
+         {
+            m_bits = ( m_bits << width ) | quint32( code );
+            m_bitCount += width;
+            while ( m_bitCount >= 8 )
+            {
+               m_bitCount -= 8;
+               m_out.append( char( m_bits >> m_bitCount ) );
+            }
+         }
+
+         void flush()
+         {
+            if ( m_bitCount > 0 )
+               m_out.append( char( m_bits << ( 8 - m_bitCount ) ) );
+            m_bitCount = 0;
+         }
+
+      private:
+         QByteArray& m_out;
+         quint32     m_bits;
+         int         m_bitCount;
+      };
+
+
+      /// Compresses @a data with TIFF's flavour of LZW (codes up to 12
+      /// bits, MSB first, the code width growing one code early).
+      QByteArray lzwCompress( const QByteArray& data )
+      {
+         // Open addressing table of (prefix code, next byte) -> code.
+         const int               HashSize( 9001 );
+         std::vector< qint32 >   keys( HashSize, -1 );
+         std::vector< quint16 >  codes( HashSize );
+
+         QByteArray  out;
+         CodeWriter  writer( out );
+         const uchar*   p( reinterpret_cast< const uchar* >( data.constData() ) );
+         const int      n( data.size() );
+         int            width( 9 ), next( LzwFirst );
+
+         out.reserve( n / 2 );
+         writer.put( LzwClear, width );
+
+         if ( n == 0 )
+         {
+            writer.put( LzwEnd, width );
+            writer.flush();
+            return out;
+         }
+
+         int   prefix( p[0] );
+
+         for ( int i = 1; i < n; ++i )
+         {
+            const int      c( p[i] );
+            const qint32   key( ( prefix << 8 ) | c );
+            int            h( ( ( c << 4 ) ^ prefix ) % HashSize );
+
+            while ( keys[h] != -1 && keys[h] != key )
+               h = ( h + 1 ) % HashSize;
+
+            if ( keys[h] == key )
+            {
+               prefix = codes[h];
+               continue;
+            }
+
+            writer.put( prefix, width );
+            keys[h] = key;
+            codes[h] = quint16( next++ );
+            prefix = c;
+
+            if ( next == ( 1 << LzwMaxBits ) - 2 )
+            {
+               // Table full: start over.
+               writer.put( LzwClear, width );
+               std::fill( keys.begin(), keys.end(), -1 );
+               width = 9;
+               next = LzwFirst;
+            }
+            else if ( next > ( 1 << width ) - 1 )
+               ++width;
+         }
+
+         // The decoder adds one more entry on reading the last code, which
+         // may widen the end code.
+         writer.put( prefix, width );
+         if ( ++next == ( 1 << LzwMaxBits ) - 2 )
+         {
+            writer.put( LzwClear, width );
+            width = 9;
+         }
+         else if ( next > ( 1 << width ) - 1 )
+            ++width;
+
+         writer.put( LzwEnd, width );
+         writer.flush();
+         return out;
+      }
+
+
+      /// Turns one strip of Format_RGB32 rows into (compressed) samples.
+      class StripEncoder : public QRunnable
+      {
+      public:
+         StripEncoder( const QImage& rows, int firstRow, int rowCount, unsigned int width,
+                       TiffWriter::Compression compression, QByteArray* out, QSemaphore* done )
+         : m_rows( rows )
+         , m_firstRow( firstRow )
+         , m_rowCount( rowCount )
+         , m_width( width )
+         , m_compression( compression )
+         , m_out( out )
+         , m_done( done )
+         { }
+
+         virtual void run()
+         {
+            ScopedTimer timer( "encode strip" );
+            QByteArray  samples;
+
+            samples.resize( int( m_width ) * 3 * m_rowCount );
+
+            uchar*      dst( reinterpret_cast< uchar* >( samples.data() ) );
+
+            for ( int y = 0; y < m_rowCount; ++y )
+            {
+               const QRgb* src( reinterpret_cast< const QRgb* >( m_rows.constScanLine( m_firstRow + y ) ) );
+
+               for ( unsigned int x = 0; x < m_width; ++x )
+               {
+                  *dst++ = uchar( qRed( src[x] ) );
+                  *dst++ = uchar( qGreen( src[x] ) );
+                  *dst++ = uchar( qBlue( src[x] ) );
+               }
+            }
+
+            switch ( m_compression )
+            {
+            case TiffWriter::Deflate:
+               // qCompress makes a zlib stream, as TIFF wants, after a
+               // 4-byte length of its own.
+               *m_out = qCompress( samples, 1 ).mid( 4 );
+               break;
+            case TiffWriter::Lzw:
+               *m_out = lzwCompress( samples );
+               break;
+            default:
+               *m_out = samples;
+               break;
+            }
+
+            m_done->release();
+         }
+
+      private:
+         const QImage&     m_rows;
+         int               m_firstRow, m_rowCount;
+         unsigned int      m_width;
+         TiffWriter::Compression m_compression;
+         QByteArray*       m_out;
+         QSemaphore*       m_done;
+      };
+   }
+
+
+
+   TiffWriter::TiffWriter()
+   : m_width( 0 )
+   , m_height( 0 )
+   , m_rowsPerStrip( 0 )
+   , m_rowsWritten( 0 )
+   , m_compression( NoCompression )
+   , m_bigTiff( false )
+   {
+   }
+
+
+   TiffWriter::~TiffWriter()
+   {
+      if ( m_file.isOpen() )
+         abandon();
+   }
+
+
+   bool TiffWriter::open( const QString& filename, unsigned int width, unsigned int height,
+                          unsigned int rowsPerStrip, Compression compression )
+   {
+      m_width = width;
+      m_height = height;
+      m_rowsPerStrip = qMax( rowsPerStrip, 1u );
+      m_rowsWritten = 0;
+      m_compression = compression;
+      m_stripOffsets.clear();
+      m_stripByteCounts.clear();
+      m_error.clear();
+
+      // Checked before the file is named so that nothing is created or removed.
+      if ( width == 0 || height == 0 )
+      {
+         m_error = QObject::tr( "A TIFF image needs at least one row and one column." );
+         return false;
+      }
+
+      // The final size isn't known until the strips are compressed, so
+      // allow for compression making things worse and for the directory.
+      const quint64  stripCount( ( quint64( height ) + m_rowsPerStrip - 1 ) / m_rowsPerStrip );
+      const quint64  rawSize( quint64( width ) * height * 3 );
+
+      m_bigTiff = rawSize * ( compression == NoCompression ? 1 : 2 ) + stripCount * 16 + 4096 >
+                  MaxClassicSize;
+
+      m_file.setFileName( filename );
+      if ( ! m_file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+         return fail( m_file.errorString() );
+
+      // Little-endian header; the directory offset is filled in by close().
+      QDataStream out( &m_file );
+
+      out.setByteOrder( QDataStream::LittleEndian );
+      out << quint8( 'I' ) << quint8( 'I' );
+      if ( m_bigTiff )
+         out << quint16( 43 ) << quint16( 8 ) << quint16( 0 ) << quint64( 0 );
+      else
+         out << quint16( 42 ) << quint32( 0 );
+
+      if ( out.status() != QDataStream::Ok )
+         return fail( m_file.errorString() );
+      return true;
+   }
+
+
+   bool TiffWriter::writeRows( const QImage& rows, unsigned int rowCount )
+   {
+      ScopedTimer timer( "write strips" );
+
+      if ( ! m_file.isOpen() )
+         return false;
+
+      rowCount = qMin( rowCount, m_height - m_rowsWritten );
+
+      const int   stripCount( int( ( rowCount + m_rowsPerStrip - 1 ) / m_rowsPerStrip ) );
+      std::vector< QByteArray >  strips( stripCount );
+      QSemaphore  done;
+
+      // Encode all the strips at once, then write them in order.
+      for ( int i = 0; i < stripCount; ++i )
+      {
+         const int   firstRow( i * int( m_rowsPerStrip ) );
+
+         QThreadPool::globalInstance()->start(
+               new StripEncoder( rows, firstRow, qMin( int( m_rowsPerStrip ), int( rowCount ) - firstRow ),
+                                 m_width, m_compression, &strips[i], &done ) );
+      }
+      done.acquire( stripCount );
+
+      for ( int i = 0; i < stripCount; ++i )
+      {
+         const quint64  offset( m_file.pos() );
+
+         if ( ! m_bigTiff && offset + strips[i].size() > MaxClassicSize )
+            return fail( QObject::tr( "The image is too large for a TIFF file." ) );
+
+         if ( m_file.write( strips[i] ) != strips[i].size() )
+            return fail( m_file.errorString() );
+
+         m_stripOffsets.push_back( offset );
+         m_stripByteCounts.push_back( quint64( strips[i].size() ) );
+      }
+
+      m_rowsWritten += rowCount;
+      return true;
+   }
+
+
+   bool TiffWriter::close()
+   {
+      if ( ! m_file.isOpen() )
+         return false;
+
+      if ( m_rowsWritten != m_height )
+         return fail( QObject::tr( "Not every row was written." ) );
+
+      const quint16  offsetType( m_bigTiff ? Long8 : Long );
+      const int      inlineSize( m_bigTiff ? 8 : 4 );
+      std::vector< quint64 >  bitsPerSample( 3, 8 );
+      std::vector< quint64 >  resolution( 2 );
+
+      resolution[0] = 72;
+      resolution[1] = 1;
+
+      // Entries must be in tag order.
+      std::vector< Field >    fields;
+
+      fields.push_back( Field( 256, Long, m_width ) );                        // ImageWidth
+      fields.push_back( Field( 257, Long, m_height ) );                       // ImageLength
+      fields.push_back( Field( 258, Short, bitsPerSample ) );                 // BitsPerSample
+      fields.push_back( Field( 259, Short, CompressionCodes[ m_compression ] ) );   // Compression
+      fields.push_back( Field( 262, Short, 2 ) );                             // Photometric: RGB
+      fields.push_back( Field( 273, offsetType, m_stripOffsets ) );           // StripOffsets
+      fields.push_back( Field( 277, Short, 3 ) );                             // SamplesPerPixel
+      fields.push_back( Field( 278, Long, m_rowsPerStrip ) );                 // RowsPerStrip
+      fields.push_back( Field( 279, offsetType, m_stripByteCounts ) );        // StripByteCounts
+      fields.push_back( Field( 282, Rational, resolution ) );                 // XResolution
+      fields.push_back( Field( 283, Rational, resolution ) );                 // YResolution
+      fields.push_back( Field( 284, Short, 1 ) );                             // PlanarConfig: chunky
+      fields.push_back( Field( 296, Short, 2 ) );                             // ResolutionUnit: inch
+
+      QDataStream out( &m_file );
+
+      out.setByteOrder( QDataStream::LittleEndian );
+
+      // Values too big for their entries go first, word aligned.
+      for ( size_t i = 0; i < fields.size(); ++i )
+      {
+         if ( fields[i].count * typeSize( fields[i].type ) > quint64( inlineSize ) )
+         {
+            if ( m_file.pos() % 2 )
+               out << quint8( 0 );
+            fields[i].offset = m_file.pos();
+            writeValues( out, fields[i] );
+         }
+      }
+
+      if ( m_file.pos() % 2 )
+         out << quint8( 0 );
+
+      const quint64  ifdOffset( m_file.pos() );
+
+      if ( ! m_bigTiff && ifdOffset + 2 + fields.size() * 12 + 4 > MaxClassicSize )
+         return fail( QObject::tr( "The image is too large for a TIFF file." ) );
+
+      if ( m_bigTiff )
+         out << quint64( fields.size() );
+      else
+         out << quint16( fields.size() );
+
+      for ( size_t i = 0; i < fields.size(); ++i )
+      {
+         const Field&   f( fields[i] );
+         const int      size( int( f.count ) * typeSize( f.type ) );
+
+         out << f.tag << f.type;
+         if ( m_bigTiff )
+            out << quint64( f.count );
+         else
+            out << quint32( f.count );
+
+         if ( size > inlineSize )
+         {
+            if ( m_bigTiff )
+               out << quint64( f.offset );
+            else
+               out << quint32( f.offset );
+         }
+         else
+         {
+            writeValues( out, f );
+            for ( int pad = size; pad < inlineSize; ++pad )
+               out << quint8( 0 );
+         }
+      }
+
+      // No further directories.
+      if ( m_bigTiff )
+         out << quint64( 0 );
+      else
+         out << quint32( 0 );
+
+      // Point the header at the directory.
+      if ( m_bigTiff )
+      {
+         m_file.seek( 8 );
+         out << quint64( ifdOffset );
+      }
+      else
+      {
+         m_file.seek( 4 );
+         out << quint32( ifdOffset );
+      }
+
+      if ( out.status() != QDataStream::Ok )
+         return fail( m_file.errorString() );
+
+      m_file.close();
+      if ( m_file.error() != QFile::NoError )
+         return fail( m_file.errorString() );
+      return true;
+   }
+
+
+   void TiffWriter::abandon()
+   {
+      m_file.close();
+      m_file.remove();
+   }
+
+
+   bool TiffWriter::fail( const QString& what )
+   {
+      m_error = what;
+      abandon();
+      return false;
+   }
+
+
+}  // namespace LP
@@ -0,0 +1,103 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPTIFFWRITER_H
+#define LPTIFFWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <vector>
+
+/// Forward decls
+class QImage;
+
+
+
+namespace LP
+{
+
+
+/**@brief Writes a 24-bit RGB TIFF a batch of strips at a time.
+
+   Strips go to the file as soon as they are written, and the directory
+   that points at them is written by close(), so only the rows passed to
+   one writeRows() call ever need to be in memory, no matter how large
+   the image is.  The strips of one call are converted (and compressed)
+   in parallel.  Images that could outgrow the 4 GB a classic TIFF can
+   address are written as BigTIFF.
+*/
+class TiffWriter
+{
+public:
+   typedef enum
+   {
+      NoCompression, Deflate, Lzw
+   } Compression;
+
+   TiffWriter();
+   /// Abandons (and removes) the file if it wasn't closed.
+   ~TiffWriter();
+
+   /**@brief Creates @a filename for an image of @a width x @a height
+      pixels, to be written in strips of @a rowsPerStrip rows.  Fails,
+      creating nothing, for an empty image.
+   */
+   bool open( const QString& filename, unsigned int width, unsigned int height,
+              unsigned int rowsPerStrip, Compression compression = NoCompression );
+
+   /**@brief Writes the next @a rowCount rows, taken from the top of
+      @a rows (Format_RGB32).
+
+      @a rowCount must be a multiple of the strip height unless these are
+      the last rows of the image.
+   */
+   bool writeRows( const QImage& rows, unsigned int rowCount );
+
+   /// Writes the directory and closes the file.
+   bool close();
+
+   /// Closes and removes the file without finishing it.
+   void abandon();
+
+   /// True if the file is being written as BigTIFF.
+   bool isBigTiff() const { return m_bigTiff; }
+
+   /// Describes what went wrong after a call returned false.
+   const QString& errorString() const { return m_error; }
+
+private:
+   bool fail( const QString& what );
+
+   QFile          m_file;
+   QString        m_error;
+
+   unsigned int   m_width, m_height, m_rowsPerStrip, m_rowsWritten;
+   Compression    m_compression;
+   bool           m_bigTiff;
+
+   std::vector< quint64 >  m_stripOffsets, m_stripByteCounts;
+};
+
+
+}  // namespace LP
+
+#endif   // LPTIFFWRITER_H
+
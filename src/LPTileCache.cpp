@@ -0,0 +1,149 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPTileCache.h"
+#include "LPImagePool.h"
+#include "LPProfiler.h"
+
+#include <QMutexLocker>
+
+#include <limits.h>
+
+
+namespace LP
+{
+   namespace
+   {
+      /// Cache cost of @a bytes bytes: KB, rounded up.
+      int costOf( qint64 bytes )
+      {
+         return int( qMin( qint64( INT_MAX ), ( bytes + 1023 ) / 1024 ) );
+      }
+   }
+
+
+
+   TileCache::Entry::~Entry()
+   {
+      if ( pool )
+         pool->release( image );
+   }
+
+
+
+   TileCache::TileCache( qint64 budget, ImagePool* pool )
+   : m_pool( pool )
+   , m_hits( 0 )
+   , m_misses( 0 )
+   {
+      setBudget( budget );
+   }
+
+
+   bool TileCache::find( const Key& key, QImage& tile )
+   {
+      QMutexLocker   lock( &m_mutex );
+      const Entry*   cached( m_cache.object( key ) );
+
+      if ( ! cached )
+      {
+         ++m_misses;
+         return false;
+      }
+
+      // QImage copies share their pixels, so this is cheap and the tile
+      // stays valid even if it is evicted once the lock is released.
+      ++m_hits;
+      tile = cached->image;
+      return true;
+   }
+
+
+   void TileCache::insert( const Key& key, const QImage& tile )
+   {
+      QMutexLocker   lock( &m_mutex );
+      const int      before( m_cache.totalCost() );
+
+      m_cache.insert( key, new Entry( tile, m_pool ), costOf( tile.byteCount() ) );
+      reportCostChange( before );
+   }
+
+
+   void TileCache::clear()
+   {
+      QMutexLocker   lock( &m_mutex );
+      const int      before( m_cache.totalCost() );
+
+      m_cache.clear();
+      reportCostChange( before );
+   }
+
+
+   void TileCache::setBudget( qint64 budget )
+   {
+      QMutexLocker   lock( &m_mutex );
+      const int      before( m_cache.totalCost() );
+
+      m_cache.setMaxCost( costOf( budget ) );
+      reportCostChange( before );
+   }
+
+
+   qint64 TileCache::budget() const
+   {
+      QMutexLocker   lock( &m_mutex );
+
+      return qint64( m_cache.maxCost() ) * 1024;
+   }
+
+
+   TileCache::Stats TileCache::stats() const
+   {
+      QMutexLocker   lock( &m_mutex );
+      Stats          s;
+
+      s.hits = m_hits;
+      s.misses = m_misses;
+      s.tileCount = m_cache.count();
+      s.bytes = qint64( m_cache.totalCost() ) * 1024;
+      return s;
+   }
+
+
+
+   void TileCache::reportCostChange( int before )
+   {
+      if ( m_cache.totalCost() != before )
+         Profiler::instance().adjustCounter( "tile cache bytes", qint64( m_cache.totalCost() - before ) * 1024 );
+   }
+
+
+
+   uint qHash( const TileCache::Key& key )
+   {
+      const Imager::RenderParams&   p( key.params );
+
+      return ::qHash( key.tile ) ^
+             ::qHash( ( p.offsetBits << 24 ) ^ ( quint64( p.width ) << 4 ) ^ p.order ) ^
+             ( p.redBitCount << 24 | p.greenBitCount << 16 | p.blueBitCount << 8 | p.grayBitCount ) ^
+             ( p.alphaBitCount << 27 | p.alphaFirst << 26 | p.byteOrder << 25 | p.bitOrder << 21 | p.planar << 20 );
+   }
+
+
+}  // namespace LP
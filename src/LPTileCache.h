@@ -0,0 +1,116 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPTILECACHE_H
+#define LPTILECACHE_H
+
+#include "LPImager.h"
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+
+
+namespace LP
+{
+
+class ImagePool;
+
+/**@brief Keeps recently decoded tiles (fixed runs of rows) of the data,
+   least recently used first out, within a memory budget.
+
+   A tile is identified by every parameter that affects its pixels plus
+   its index, so tiles of any number of settings can be held at once and
+   going back to an earlier setting costs no decoding.  Safe to use from
+   several threads.
+*/
+class TileCache
+{
+public:
+   /// Rows per tile; tile n holds rows n * TileRows .. (n+1) * TileRows - 1.
+   enum { TileRows = 256 };
+
+   struct Key
+   {
+      Key( const Imager::RenderParams& p, quint64 t ) : params( p ), tile( t ) { }
+
+      bool operator==( const Key& other ) const
+      {
+         return tile == other.tile && params == other.params;
+      }
+
+      Imager::RenderParams   params;
+      quint64                tile;
+   };
+
+   struct Stats
+   {
+      quint64  hits, misses;
+      int      tileCount;
+      /// Memory held by the cached tiles.
+      qint64   bytes;
+   };
+
+   /// Creates a cache that holds up to @a budget bytes of tiles, handing
+   /// the tiles it drops back to @a pool if one is given.
+   TileCache( qint64 budget, ImagePool* pool = NULL );
+
+   /// Copies the tile for @a key into @a tile and returns true, if cached.
+   bool find( const Key& key, QImage& tile );
+   /// Adds (or replaces) the tile for @a key, evicting old tiles as needed.
+   void insert( const Key& key, const QImage& tile );
+   /// Drops every tile (the statistics are kept).
+   void clear();
+
+   /// Sets the memory budget in bytes, evicting tiles if it shrank.
+   void setBudget( qint64 budget );
+   qint64 budget() const;
+
+   Stats stats() const;
+
+private:
+   /// A cached tile, whose pixels go back to the pool when it is dropped.
+   struct Entry
+   {
+      Entry( const QImage& i, ImagePool* p ) : image( i ), pool( p ) { }
+      ~Entry();
+
+      QImage      image;
+      ImagePool*  pool;
+   };
+
+   /// Tells the profiler how much the cache grew or shrank since its
+   /// total cost was @a before; m_mutex must be held.
+   void reportCostChange( int before );
+
+   mutable QMutex    m_mutex;
+   /// Costs are in KB, which keeps them within an int.
+   QCache< Key, Entry >    m_cache;
+   ImagePool*        m_pool;
+   quint64           m_hits, m_misses;
+};
+
+
+uint qHash( const TileCache::Key& key );
+
+
+}  // namespace LP
+
+#endif   // LPTILECACHE_H
+
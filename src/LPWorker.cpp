@@ -0,0 +1,90 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#include "LPWorker.h"
+
+
+namespace LPUI
+{
+
+
+WorkerOwner::WorkerOwner( QObject* parent )
+: QObject( parent )
+, m_worker( NULL )
+{
+}
+
+
+WorkerOwner::~WorkerOwner()
+{
+   stop();
+}
+
+
+
+void WorkerOwner::start( Worker* worker, QThread::Priority priority )
+{
+   stop();
+   m_worker = worker;
+
+   connect(m_worker,
+      SIGNAL(finished()),
+      SLOT(onWorkerFinished()));
+
+   m_worker->start( priority );
+}
+
+
+
+void WorkerOwner::stop()
+{
+   if ( m_worker )
+   {
+      m_worker->cancel();
+      m_worker->wait();
+      delete m_worker;
+      m_worker = NULL;
+   }
+}
+
+
+
+void WorkerOwner::cancel()
+{
+   if ( m_worker )
+      m_worker->cancel();
+}
+
+
+
+void WorkerOwner::onWorkerFinished()
+{
+   // Ignore notifications from workers that stop() already disposed of.
+   if ( ! m_worker || m_worker->isRunning() )
+      return;
+
+   Worker*  worker( m_worker );
+
+   m_worker = NULL;
+   emit finished( worker );
+   delete worker;
+}
+
+
+}  // namespace LPUI
@@ -0,0 +1,99 @@
+/******************************************************************************
+* Loom Previewer
+* Copyright (C) 2013 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef LPWORKER_H
+#define LPWORKER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QThread>
+
+
+namespace LPUI
+{
+
+
+/**@brief Work done off the GUI thread that can be asked to stop early.
+
+   Subclasses implement run() and poll isCancelled(), or hand
+   cancelFlag() to the LP calls that take one.  Workers are started,
+   stopped and disposed of by a WorkerOwner.
+*/
+class Worker : public QThread
+{
+public:
+   Worker() : QThread() { }
+
+   /// Asks run() to stop as soon as it can, without waiting for it.
+   void cancel() { m_cancel.fetchAndStoreOrdered( 1 ); }
+   bool isCancelled() { return m_cancel.fetchAndAddRelaxed( 0 ) != 0; }
+
+protected:
+   /// The flag cancel() sets, for the LP calls that poll one.
+   QAtomicInt* cancelFlag() { return &m_cancel; }
+
+private:
+   QAtomicInt  m_cancel;
+};
+
+
+/**@brief Runs at most one Worker at a time on behalf of a widget.
+
+   A worker that finishes is announced with finished() and deleted once
+   the receivers are done with it.  One that is stopped is cancelled,
+   waited for and deleted on the spot, and the notification it may
+   already have queued is ignored.
+*/
+class WorkerOwner : public QObject
+{
+   Q_OBJECT
+
+public:
+   /// Standard constructor
+   WorkerOwner( QObject* parent = 0 );
+   /// Stops the worker, if any.
+   virtual ~WorkerOwner();
+
+   /// Stops the current worker, then starts @a worker, taking ownership of it.
+   void start( Worker* worker, QThread::Priority priority = QThread::InheritPriority );
+   /// Cancels, waits for and deletes the current worker, if any.
+   void stop();
+   /// Asks the current worker to stop without waiting for it; it is still
+   /// announced when it finishes.
+   void cancel();
+
+   /// The worker running (or finished but not yet announced), or NULL.
+   Worker* worker() const { return m_worker; }
+
+signals:
+   /// Emitted when @a worker has finished without being stopped; it is
+   /// deleted once this returns, and a new worker may be started meanwhile.
+   void finished( LPUI::Worker* worker );
+
+private slots:
+   void onWorkerFinished();
+
+private:
+   Worker*  m_worker;
+};
+
+
+}  // namespace LPUI
+
+#endif   // LPWORKER_H